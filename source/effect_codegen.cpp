@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "effect_codegen.hpp"
+#include <cctype> // isalnum, isdigit
+#include <algorithm> // std::count
+#include <unordered_map>
+
+using namespace reshadefx;
+
+template <typename F>
+static void for_each_identifier(std::string_view code, F callback)
+{
+	for (size_t i = 0; i < code.size();)
+	{
+		if (!isalnum(static_cast<unsigned char>(code[i])) && code[i] != '_')
+		{
+			++i;
+			continue;
+		}
+
+		const size_t begin = i;
+		while (i < code.size() && (isalnum(static_cast<unsigned char>(code[i])) || code[i] == '_'))
+			++i;
+
+		// Skip numeric literals
+		if (!isdigit(static_cast<unsigned char>(code[begin])))
+			callback(code.substr(begin, i - begin));
+	}
+}
+
+std::vector<std::vector<bool>> reshadefx::find_referenced_definitions(const std::string &global_block, const std::vector<global_definition> &definitions, const std::vector<std::string_view> &external_names, const std::vector<std::string> &root_names)
+{
+	const size_t num_definitions = definitions.size();
+
+	// External declarations are treated like additional definitions (that do not reference anything) following the global ones
+	std::unordered_map<std::string_view, size_t> name_to_definition;
+	for (size_t i = 0; i < num_definitions; ++i)
+		for (const std::string &name : definitions[i].names)
+			name_to_definition.emplace(name, i);
+	for (size_t i = 0; i < external_names.size(); ++i)
+		name_to_definition.emplace(external_names[i], num_definitions + i);
+
+	// Find the names each definition references in its code
+	std::vector<std::vector<size_t>> references(num_definitions);
+	for (size_t i = 0, begin = 0; i < num_definitions; begin = definitions[i++].end)
+	{
+		for_each_identifier(std::string_view(global_block).substr(begin, definitions[i].end - begin), [&](std::string_view identifier) {
+			if (const auto it = name_to_definition.find(identifier); it != name_to_definition.end() && it->second != i)
+				references[i].push_back(it->second);
+		});
+	}
+
+	std::vector<std::vector<bool>> result(root_names.size());
+
+	for (size_t root_index = 0; root_index < root_names.size(); ++root_index)
+	{
+		const auto root = name_to_definition.find(root_names[root_index]);
+		if (root == name_to_definition.end())
+			continue;
+
+		std::vector<bool> &referenced = result[root_index];
+		referenced.resize(num_definitions + external_names.size());
+		referenced[root->second] = true;
+
+		for (std::vector<size_t> worklist = { root->second }; !worklist.empty();)
+		{
+			const size_t i = worklist.back();
+			worklist.pop_back();
+
+			if (i >= num_definitions)
+				continue;
+
+			for (const size_t reference : references[i])
+			{
+				if (!referenced[reference])
+				{
+					referenced[reference] = true;
+					worklist.push_back(reference);
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+void reshadefx::append_referenced_definitions(std::string &code, const std::string &global_block, const std::vector<global_definition> &definitions, const std::vector<bool> &referenced, size_t first_line, bool line_directives)
+{
+	size_t line = first_line;
+
+	for (size_t i = 0, begin = 0; i < definitions.size(); begin = definitions[i++].end)
+	{
+		const size_t end = definitions[i].end;
+
+		if (referenced[i])
+		{
+			// Keep line numbers the same as in the code containing all entry points, so that errors point to the right place in it
+			if (line_directives)
+				code += "#line " + std::to_string(line) + '\n';
+
+			code.append(global_block, begin, end - begin);
+		}
+
+		line += std::count(global_block.begin() + begin, global_block.begin() + end, '\n');
+	}
+}
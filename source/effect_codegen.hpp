@@ -8,6 +8,7 @@
 #include "effect_module.hpp"
 #include <memory> // std::unique_ptr
 #include <algorithm> // std::find_if
+#include <string_view>
 
 namespace reshadefx
 {
@@ -360,5 +361,34 @@ namespace reshadefx
 	/// <param name="uniforms_to_spec_constants">Whether to convert uniform variables to specialization constants.</param>
 	/// <param name="enable_16bit_types">Use real 16-bit types for the minimum precision types "min16int", "min16uint" and "min16float".</param>
 	/// <param name="flip_vert_y">Insert code to flip the Y component of the output position in vertex shaders.</param>
-	codegen *create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types = false, bool flip_vert_y = false);
+	/// <param name="optimize">Whether to run optimization passes (inlining, promotion of local variables, constant folding and dead code elimination) over the generated code.</param>
+	codegen *create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types = false, bool flip_vert_y = false, bool optimize = false);
+
+	/// <summary>
+	/// A definition in the global code block of the HLSL and GLSL code generators.
+	/// </summary>
+	struct global_definition
+	{
+		// Offset in the global block at which this definition ends (it starts where the previous one ended)
+		size_t end;
+		// Names declared by this definition, which other code uses to reference it
+		std::vector<std::string> names;
+	};
+
+	/// <summary>
+	/// Find the definitions in a global code block that are referenced (directly or through other definitions) by each of the specified root definitions.
+	/// This is used to generate code for each entry point that only contains the definitions it actually needs.
+	/// </summary>
+	/// <param name="global_block">The code block containing all the definitions one after another.</param>
+	/// <param name="definitions">The list of definitions in the code block.</param>
+	/// <param name="external_names">Names of additional declarations outside the code block (e.g. constant buffer members), which are appended after the definitions in the result.</param>
+	/// <param name="root_names">Names declared by the root definitions.</param>
+	/// <returns>A list of flags for every definition and external declaration per root name, indicating whether it is referenced, or an empty list if the root name was not found.</returns>
+	std::vector<std::vector<bool>> find_referenced_definitions(const std::string &global_block, const std::vector<global_definition> &definitions, const std::vector<std::string_view> &external_names, const std::vector<std::string> &root_names);
+	/// <summary>
+	/// Append the code of all referenced definitions in a global code block to the specified <paramref name="code"/>.
+	/// </summary>
+	/// <param name="first_line">Line number the code block starts at in the code containing all definitions.</param>
+	/// <param name="line_directives">Whether to insert line directives in front of every definition, so that line numbers stay the same as in the code containing all definitions.</param>
+	void append_referenced_definitions(std::string &code, const std::string &global_block, const std::vector<global_definition> &definitions, const std::vector<bool> &referenced, size_t first_line, bool line_directives);
 }
@@ -39,6 +39,7 @@ private:
 
 	std::string _ubo_block;
 	std::string _compute_block;
+	std::vector<global_definition> _global_definitions;
 	std::unordered_map<id, std::string> _names;
 	std::unordered_map<id, std::string> _blocks;
 	bool _debug_info = false;
@@ -59,14 +60,16 @@ private:
 	{
 		module = std::move(_module);
 
+		std::string preamble;
+
 		if (_enable_16bit_types)
 			// GL_NV_gpu_shader5, GL_AMD_gpu_shader_half_float or GL_EXT_shader_16bit_storage
-			module.hlsl += "#extension GL_NV_gpu_shader5 : require\n";
+			preamble += "#extension GL_NV_gpu_shader5 : require\n";
 		if (_enable_control_flow_attributes)
-			module.hlsl += "#extension GL_EXT_control_flow_attributes : enable\n";
+			preamble += "#extension GL_EXT_control_flow_attributes : enable\n";
 
 		if (_uses_fmod)
-			module.hlsl += "float fmodHLSL(float x, float y) { return x - y * trunc(x / y); }\n"
+			preamble += "float fmodHLSL(float x, float y) { return x - y * trunc(x / y); }\n"
 				"vec2 fmodHLSL(vec2 x, vec2 y) { return x - y * trunc(x / y); }\n"
 				"vec3 fmodHLSL(vec3 x, vec3 y) { return x - y * trunc(x / y); }\n"
 				"vec4 fmodHLSL(vec4 x, vec4 y) { return x - y * trunc(x / y); }\n"
@@ -74,17 +77,17 @@ private:
 				"mat3 fmodHLSL(mat3 x, mat3 y) { return x - matrixCompMult(y, mat3(trunc(x[0] / y[0]), trunc(x[1] / y[1]), trunc(x[2] / y[2]))); }\n"
 				"mat4 fmodHLSL(mat4 x, mat4 y) { return x - matrixCompMult(y, mat4(trunc(x[0] / y[0]), trunc(x[1] / y[1]), trunc(x[2] / y[2]), trunc(x[3] / y[3]))); }\n";
 		if (_uses_componentwise_or)
-			module.hlsl +=
+			preamble +=
 				"bvec2 compOr(bvec2 a, bvec2 b) { return bvec2(a.x || b.x, a.y || b.y); }\n"
 				"bvec3 compOr(bvec3 a, bvec3 b) { return bvec3(a.x || b.x, a.y || b.y, a.z || b.z); }\n"
 				"bvec4 compOr(bvec4 a, bvec4 b) { return bvec4(a.x || b.x, a.y || b.y, a.z || b.z, a.w || b.w); }\n";
 		if (_uses_componentwise_and)
-			module.hlsl +=
+			preamble +=
 				"bvec2 compAnd(bvec2 a, bvec2 b) { return bvec2(a.x && b.x, a.y && b.y); }\n"
 				"bvec3 compAnd(bvec3 a, bvec3 b) { return bvec3(a.x && b.x, a.y && b.y, a.z && b.z); }\n"
 				"bvec4 compAnd(bvec4 a, bvec4 b) { return bvec4(a.x && b.x, a.y && b.y, a.z && b.z, a.w && b.w); }\n";
 		if (_uses_componentwise_cond)
-			module.hlsl +=
+			preamble +=
 				"vec2 compCond(bvec2 cond, vec2 a, vec2 b) { return vec2(cond.x ? a.x : b.x, cond.y ? a.y : b.y); }\n"
 				"vec3 compCond(bvec3 cond, vec3 a, vec3 b) { return vec3(cond.x ? a.x : b.x, cond.y ? a.y : b.y, cond.z ? a.z : b.z); }\n"
 				"vec4 compCond(bvec4 cond, vec4 a, vec4 b) { return vec4(cond.x ? a.x : b.x, cond.y ? a.y : b.y, cond.z ? a.z : b.z, cond.w ? a.w : b.w); }\n"
@@ -98,9 +101,43 @@ private:
 		if (!_ubo_block.empty())
 			// Read matrices in column major layout, even though they are actually row major, to avoid transposing them on every access (since GLSL uses column matrices)
 			// TODO: This technically only works with square matrices
-			module.hlsl += "layout(std140, column_major, binding = 0) uniform _Globals {\n" + _ubo_block + "};\n";
+			preamble += "layout(std140, column_major, binding = 0) uniform _Globals {\n" + _ubo_block + "};\n";
 
+		module.hlsl += preamble;
 		module.hlsl += _blocks.at(0);
+
+		write_entry_point_results(module, preamble);
+	}
+
+	/// <summary>
+	/// Generates code for each entry point that only contains the definitions it references, so that the GLSL compiler does not have to parse the entire effect for every shader.
+	/// </summary>
+	void write_entry_point_results(module &module, const std::string &preamble) const
+	{
+		const std::string &global_block = _blocks.at(0);
+
+		// Each entry point is wrapped in a section that is enabled with a define of the same name
+		std::vector<std::string> entry_point_names;
+		for (const entry_point &entry_point : module.entry_points)
+			entry_point_names.push_back("ENTRY_POINT_" + entry_point.name);
+
+		const std::vector<std::vector<bool>> referenced_definitions = find_referenced_definitions(global_block, _global_definitions, {}, entry_point_names);
+
+		const size_t preamble_lines = std::count(preamble.begin(), preamble.end(), '\n');
+
+		for (size_t entry_point_index = 0; entry_point_index < module.entry_points.size(); ++entry_point_index)
+		{
+			entry_point &entry_point = module.entry_points[entry_point_index];
+
+			const std::vector<bool> &referenced = referenced_definitions[entry_point_index];
+			if (referenced.empty())
+				continue;
+
+			// Keep the uniform block as is, since its members cannot be assigned explicit offsets in GLSL 4.30
+			entry_point.hlsl += preamble;
+
+			append_referenced_definitions(entry_point.hlsl, global_block, _global_definitions, referenced, preamble_lines + 1, !_debug_info);
+		}
 	}
 
 	template <bool is_param = false, bool is_decl = true, bool is_interface = false>
@@ -327,6 +364,11 @@ private:
 		_names[id] = std::move(name);
 	}
 
+	void finish_global_definition(std::vector<std::string> names)
+	{
+		_global_definitions.push_back({ _blocks.at(0).size(), std::move(names) });
+	}
+
 	uint32_t semantic_to_location(const std::string &semantic, uint32_t max_array_length = 1)
 	{
 		if (semantic.compare(0, 5, "COLOR") == 0)
@@ -458,6 +500,8 @@ private:
 
 		code += "};\n";
 
+		finish_global_definition({ id_to_name(info.definition) });
+
 		return info.definition;
 	}
 	id   define_texture(const location &, texture_info &info) override
@@ -483,6 +527,8 @@ private:
 
 		code += "layout(binding = " + std::to_string(info.binding) + ") uniform sampler2D " + id_to_name(info.id) + ";\n";
 
+		finish_global_definition({ id_to_name(info.id) });
+
 		_module.samplers.push_back(info);
 
 		return info.id;
@@ -500,6 +546,8 @@ private:
 
 		code += "layout(binding = " + std::to_string(info.binding) + ") uniform writeonly image2D " + id_to_name(info.id) + ";\n";
 
+		finish_global_definition({ id_to_name(info.id) });
+
 		_module.storages.push_back(info);
 
 		return info.id;
@@ -527,6 +575,8 @@ private:
 				write_type<false, false>(code, info.type);
 			code += "(SPEC_CONSTANT_" + info.name + ");\n";
 
+			finish_global_definition({ id_to_name(res) });
+
 			_module.spec_constants.push_back(info);
 		}
 		else
@@ -604,6 +654,9 @@ private:
 
 		code += ";\n";
 
+		if (global)
+			finish_global_definition({ id_to_name(res) });
+
 		return res;
 	}
 	id   define_function(const location &loc, function_info &info) override
@@ -672,7 +725,9 @@ private:
 			[&func](const auto &ep) { return ep.name == func.unique_name; }); it != _module.entry_points.end())
 			return;
 
-		_module.entry_points.push_back({ func.unique_name, stype });
+		entry_point &new_entry_point = _module.entry_points.emplace_back();
+		new_entry_point.name = func.unique_name;
+		new_entry_point.type = stype;
 
 		_blocks.at(0) += "#ifdef ENTRY_POINT_" + func.unique_name + '\n';
 		if (stype == shader_type::cs)
@@ -1018,6 +1073,9 @@ private:
 		leave_function();
 
 		_blocks.at(0) += "#endif\n";
+
+		// Extend the definition of the wrapper function to cover the entire section, so that it is looked up via the define that enables it instead of the "main" name all entry points share
+		_global_definitions.back() = { _blocks.at(0).size(), { "ENTRY_POINT_" + func.unique_name } };
 	}
 
 	id   emit_load(const expression &exp, bool force_new_id) override
@@ -1884,6 +1942,8 @@ private:
 		assert(_last_block != 0);
 
 		_blocks.at(0) += "{\n" + _blocks.at(_last_block) + "}\n";
+
+		finish_global_definition({ id_to_name(_functions.back()->definition) });
 	}
 };
 
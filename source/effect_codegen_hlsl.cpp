@@ -35,8 +35,18 @@ private:
 		expression,
 	};
 
+	struct cbuffer_member
+	{
+		std::string name;
+		// Range of the declaration in the constant buffer block
+		size_t begin, end;
+		uint32_t offset;
+	};
+
 	std::string _cbuffer_block;
 	std::string _current_location;
+	std::vector<global_definition> _global_definitions;
+	std::vector<cbuffer_member> _cbuffer_members;
 	std::unordered_map<id, std::string> _names;
 	std::unordered_map<id, std::string> _blocks;
 	bool _debug_info = false;
@@ -50,19 +60,18 @@ private:
 	{
 		module = std::move(_module);
 
+		std::string preamble;
+
 		if (_shader_model >= 40)
 		{
-			module.hlsl += "struct __sampler2D { Texture2D t; SamplerState s; };\n";
-
-			if (!_cbuffer_block.empty())
-				module.hlsl += "cbuffer _Globals {\n" + _cbuffer_block + "};\n";
+			preamble += "struct __sampler2D { Texture2D t; SamplerState s; };\n";
 		}
 		else
 		{
-			module.hlsl += "struct __sampler2D { sampler2D s; float2 pixelsize; };\nuniform float2 __TEXEL_SIZE__ : register(c255);\n";
+			preamble += "struct __sampler2D { sampler2D s; float2 pixelsize; };\nuniform float2 __TEXEL_SIZE__ : register(c255);\n";
 
 			if (_uses_bitwise_cast)
-				module.hlsl +=
+				preamble +=
 					"int __asint(float v) {"
 					"	if (v == 0) return 0;" // Zero (does not handle negative zero)
 					//	if (isinf(v)) return v < 0 ? 4286578688 : 2139095040; // Infinity
@@ -94,14 +103,83 @@ private:
 					"float3 __asfloat(int3 v) { return float3(__asfloat(v.x), __asfloat(v.y), __asfloat(v.z)); }\n"
 					"float4 __asfloat(int4 v) { return float4(__asfloat(v.x), __asfloat(v.y), __asfloat(v.z), __asfloat(v.w)); }\n";
 
-			if (!_cbuffer_block.empty())
-				module.hlsl += _cbuffer_block;
-
 			// Offsets were multiplied in 'define_uniform', so adjust total size here accordingly
 			module.total_uniform_size *= 4;
 		}
 
+		module.hlsl += preamble;
+
+		if (!_cbuffer_block.empty())
+		{
+			if (_shader_model >= 40)
+				module.hlsl += "cbuffer _Globals {\n" + _cbuffer_block + "};\n";
+			else
+				module.hlsl += _cbuffer_block;
+		}
+
 		module.hlsl += _blocks.at(0);
+
+		write_entry_point_results(module, preamble);
+	}
+
+	/// <summary>
+	/// Generates code for each entry point that only contains the definitions it references, so that the HLSL compiler does not have to parse the entire effect for every shader.
+	/// </summary>
+	void write_entry_point_results(module &module, const std::string &preamble) const
+	{
+		const std::string &global_block = _blocks.at(0);
+		const size_t num_definitions = _global_definitions.size();
+
+		// Constant buffer members are treated like additional declarations following the global definitions
+		std::vector<std::string_view> cbuffer_member_names;
+		for (const cbuffer_member &member : _cbuffer_members)
+			cbuffer_member_names.push_back(member.name);
+		std::vector<std::string> entry_point_names;
+		for (const entry_point &entry_point : module.entry_points)
+			entry_point_names.push_back(entry_point.name);
+
+		const std::vector<std::vector<bool>> referenced_definitions = find_referenced_definitions(global_block, _global_definitions, cbuffer_member_names, entry_point_names);
+
+		const size_t preamble_lines = std::count(module.hlsl.begin(), module.hlsl.end() - global_block.size(), '\n');
+
+		for (size_t entry_point_index = 0; entry_point_index < module.entry_points.size(); ++entry_point_index)
+		{
+			entry_point &entry_point = module.entry_points[entry_point_index];
+
+			const std::vector<bool> &referenced = referenced_definitions[entry_point_index];
+			if (referenced.empty())
+				continue;
+
+			entry_point.hlsl += preamble;
+
+			if (_shader_model >= 40)
+			{
+				std::string cbuffer_block;
+				for (size_t i = 0; i < _cbuffer_members.size(); ++i)
+				{
+					if (!referenced[num_definitions + i])
+						continue;
+
+					const cbuffer_member &member = _cbuffer_members[i];
+
+					// Pin the remaining members to their original offsets, so that the layout of the constant buffer does not change
+					cbuffer_block.append(_cbuffer_block, member.begin, member.end - member.begin - 2);
+					cbuffer_block += " : packoffset(c" + std::to_string(member.offset / 16) + '.' + "xyzw"[(member.offset % 16) / 4] + ");\n";
+				}
+
+				if (!cbuffer_block.empty())
+					entry_point.hlsl += "cbuffer _Globals {\n" + cbuffer_block + "};\n";
+			}
+			else
+			{
+				// Uniforms are already explicitly assigned to constant registers in shader model 3
+				for (size_t i = 0; i < _cbuffer_members.size(); ++i)
+					if (referenced[num_definitions + i])
+						entry_point.hlsl.append(_cbuffer_block, _cbuffer_members[i].begin, _cbuffer_members[i].end - _cbuffer_members[i].begin);
+			}
+
+			append_referenced_definitions(entry_point.hlsl, global_block, _global_definitions, referenced, preamble_lines + 1, !_debug_info);
+		}
 	}
 
 	template <bool is_param = false, bool is_decl = true>
@@ -312,6 +390,14 @@ private:
 		_names[id] = std::move(name);
 	}
 
+	void finish_global_definition(std::vector<std::string> names)
+	{
+		_global_definitions.push_back({ _blocks.at(0).size(), std::move(names) });
+
+		// Write the file name again in the next definition, since the one that set it may be left out of the code for an entry point
+		_current_location.clear();
+	}
+
 	std::string convert_semantic(const std::string &semantic) const
 	{
 		if (_shader_model < 40)
@@ -395,6 +481,8 @@ private:
 
 		code += "};\n";
 
+		finish_global_definition({ id_to_name(info.definition) });
+
 		return info.definition;
 	}
 	id   define_texture(const location &loc, texture_info &info) override
@@ -415,6 +503,8 @@ private:
 
 			code += "Texture2D __"     + info.unique_name + " : register(t" + std::to_string(info.binding + 0) + ");\n";
 			code += "Texture2D __srgb" + info.unique_name + " : register(t" + std::to_string(info.binding + 1) + ");\n";
+
+			finish_global_definition({ "__" + info.unique_name, "__srgb" + info.unique_name });
 		}
 
 		_module.textures.push_back(info);
@@ -432,6 +522,7 @@ private:
 		assert(texture != _module.textures.end());
 
 		std::string &code = _blocks.at(_current_block);
+		std::vector<std::string> names = { id_to_name(info.id) };
 
 		if (_shader_model >= 40)
 		{
@@ -448,6 +539,8 @@ private:
 				info.binding = _module.num_sampler_bindings++;
 
 				code += "SamplerState __s" + std::to_string(info.binding) + " : register(s" + std::to_string(info.binding) + ");\n";
+
+				names.push_back("__s" + std::to_string(info.binding));
 			}
 
 			assert(info.srgb == 0 || info.srgb == 1);
@@ -476,6 +569,8 @@ private:
 			code += ") }; \n";
 		}
 
+		finish_global_definition(std::move(names));
+
 		_module.samplers.push_back(info);
 
 		return info.id;
@@ -496,6 +591,8 @@ private:
 			write_location(code, loc);
 
 			code += "RWTexture2D<float4> " + info.unique_name + " : register(u" + std::to_string(info.binding) + ");\n";
+
+			finish_global_definition({ info.unique_name });
 		}
 
 		_module.storages.push_back(info);
@@ -525,6 +622,8 @@ private:
 				write_type<false, false>(code, info.type);
 			code += "(SPEC_CONSTANT_" + info.name + ");\n";
 
+			finish_global_definition({ id_to_name(res) });
+
 			_module.spec_constants.push_back(info);
 		}
 		else
@@ -546,6 +645,8 @@ private:
 				info.offset += remaining;
 			_module.total_uniform_size = info.offset + info.size;
 
+			const size_t begin = _cbuffer_block.size();
+
 			write_location<true>(_cbuffer_block, loc);
 
 			if (_shader_model >= 40)
@@ -579,6 +680,8 @@ private:
 
 			_cbuffer_block += ";\n";
 
+			_cbuffer_members.push_back({ id_to_name(res), begin, _cbuffer_block.size(), info.offset });
+
 			_module.uniforms.push_back(info);
 		}
 
@@ -609,6 +712,9 @@ private:
 
 		code += ";\n";
 
+		if (global)
+			finish_global_definition({ id_to_name(res) });
+
 		return res;
 	}
 	id   define_function(const location &loc, function_info &info) override
@@ -674,7 +780,9 @@ private:
 			[&func](const auto &ep) { return ep.name == func.unique_name; }); it != _module.entry_points.end())
 			return;
 
-		_module.entry_points.push_back({ func.unique_name, stype });
+		entry_point &new_entry_point = _module.entry_points.emplace_back();
+		new_entry_point.name = func.unique_name;
+		new_entry_point.type = stype;
 
 		// Only have to rewrite the entry point function signature in shader model 3 and for compute (to write "numthreads" attribute)
 		if (_shader_model >= 40 && stype != shader_type::cs)
@@ -1645,6 +1753,8 @@ private:
 		assert(_last_block != 0);
 
 		_blocks.at(0) += "{\n" + _blocks.at(_last_block) + "}\n";
+
+		finish_global_definition({ id_to_name(_functions.back()->definition) });
 	}
 };
 
@@ -7,8 +7,12 @@
 #include "effect_codegen.hpp"
 #include <cassert>
 #include <cstring> // memcmp
+#include <map>
+#include <limits>
 #include <algorithm> // std::find_if, std::max
 #include <unordered_set>
+#include <unordered_map>
+#include <memory_resource>
 
 // Use the C++ variant of the SPIR-V headers
 #include <spirv.hpp>
@@ -26,11 +30,15 @@ struct spirv_instruction
 	spv::Op op;
 	spv::Id type;
 	spv::Id result;
-	std::vector<spv::Id> operands;
+	std::pmr::vector<spv::Id> operands;
 
-	explicit spirv_instruction(spv::Op op = spv::OpNop) : op(op), type(0), result(0) {}
-	spirv_instruction(spv::Op op, spv::Id result) : op(op), type(result), result(0) {}
-	spirv_instruction(spv::Op op, spv::Id type, spv::Id result) : op(op), type(type), result(result) {}
+	// Instructions are always constructed with the memory resource to allocate their operands from (usually the arena of the code generator)
+	spirv_instruction(spv::Op op, std::pmr::memory_resource *memory) : op(op), type(0), result(0), operands(memory) {}
+	// Copies keep allocating from the same memory resource as the original instruction (instead of falling back to the default one)
+	spirv_instruction(const spirv_instruction &other) : op(other.op), type(other.type), result(other.result), operands(other.operands, other.operands.get_allocator()) {}
+	spirv_instruction(spirv_instruction &&other) = default;
+	spirv_instruction &operator=(const spirv_instruction &other) = default;
+	spirv_instruction &operator=(spirv_instruction &&other) = default;
 
 	/// <summary>
 	/// Add a single operand to the instruction.
@@ -116,8 +124,8 @@ struct spirv_basic_block
 class codegen_spirv final : public codegen
 {
 public:
-	codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y)
-		: _debug_info(debug_info), _vulkan_semantics(vulkan_semantics), _uniforms_to_spec_constants(uniforms_to_spec_constants), _enable_16bit_types(enable_16bit_types), _flip_vert_y(flip_vert_y)
+	codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y, bool optimize)
+		: _debug_info(debug_info), _vulkan_semantics(vulkan_semantics), _uniforms_to_spec_constants(uniforms_to_spec_constants), _enable_16bit_types(enable_16bit_types), _flip_vert_y(flip_vert_y), _optimize(optimize)
 	{
 		_glsl_ext = make_id();
 	}
@@ -134,6 +142,75 @@ private:
 		{
 			return lhs.type == rhs.type && lhs.is_ptr == rhs.is_ptr && lhs.array_stride == rhs.array_stride && lhs.storage == rhs.storage;
 		}
+
+		struct hash
+		{
+			size_t operator()(const type_lookup &lookup) const
+			{
+				size_t result = hash_type(lookup.type);
+				hash_combine(result, lookup.is_ptr);
+				hash_combine(result, lookup.array_stride);
+				hash_combine(result, lookup.storage);
+				return result;
+			}
+		};
+	};
+	struct function_type_lookup
+	{
+		type return_type;
+		std::vector<type> param_types;
+
+		friend bool operator==(const function_type_lookup &lhs, const function_type_lookup &rhs)
+		{
+			if (lhs.param_types.size() != rhs.param_types.size())
+				return false;
+			for (size_t i = 0; i < lhs.param_types.size(); ++i)
+				if (!(lhs.param_types[i] == rhs.param_types[i]))
+					return false;
+			return lhs.return_type == rhs.return_type;
+		}
+
+		struct hash
+		{
+			size_t operator()(const function_type_lookup &lookup) const
+			{
+				size_t result = hash_type(lookup.return_type);
+				for (const type &param_type : lookup.param_types)
+					hash_combine(result, hash_type(param_type));
+				return result;
+			}
+		};
+	};
+	struct constant_lookup
+	{
+		reshadefx::type type;
+		reshadefx::constant data;
+
+		// Only compares the numeric data of the constant (and its array elements), which is all that is used to define a SPIR-V constant
+		friend bool operator==(const constant_lookup &lhs, const constant_lookup &rhs)
+		{
+			if (!(lhs.type == rhs.type && std::memcmp(&lhs.data.as_uint[0], &rhs.data.as_uint[0], sizeof(uint32_t) * 16) == 0 && lhs.data.array_data.size() == rhs.data.array_data.size()))
+				return false;
+			for (size_t i = 0; i < lhs.data.array_data.size(); ++i)
+				if (std::memcmp(&lhs.data.array_data[i].as_uint[0], &rhs.data.array_data[i].as_uint[0], sizeof(uint32_t) * 16) != 0)
+					return false;
+			return true;
+		}
+
+		struct hash
+		{
+			size_t operator()(const constant_lookup &lookup) const
+			{
+				size_t result = hash_type(lookup.type);
+				for (uint32_t value : lookup.data.as_uint)
+					hash_combine(result, value);
+				hash_combine(result, lookup.data.array_data.size());
+				for (const constant &element : lookup.data.array_data)
+					for (uint32_t value : element.as_uint)
+						hash_combine(result, value);
+				return result;
+			}
+		};
 	};
 	struct function_blocks
 	{
@@ -142,200 +219,1870 @@ private:
 		spirv_basic_block definition;
 		type return_type;
 		std::vector<type> param_types;
+	};
+
+	template <typename T>
+	static void hash_combine(size_t &seed, const T &value)
+	{
+		seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
+	static size_t hash_type(const type &info)
+	{
+		// Has to be consistent with the equality operator of 'type', so qualifiers are not included
+		size_t result = std::hash<uint32_t>()(info.base);
+		hash_combine(result, info.rows);
+		hash_combine(result, info.cols);
+		hash_combine(result, info.array_length);
+		hash_combine(result, info.definition);
+		return result;
+	}
+
+	// Arena that the operands of all instructions are allocated from, so that they are released in one go when code generation is done
+	// This is declared before all basic blocks, so that it is only destroyed after them (and is mutable, so that temporary instructions created while writing the module can use it too)
+	mutable std::pmr::monotonic_buffer_resource _memory;
+
+	spirv_basic_block _entries;
+	spirv_basic_block _execution_modes;
+	spirv_basic_block _debug_a;
+	spirv_basic_block _debug_b;
+	spirv_basic_block _annotations;
+	spirv_basic_block _types_and_constants;
+	spirv_basic_block _variables;
+
+	std::unordered_set<spv::Id> _spec_constants;
+	std::unordered_set<spv::Capability> _capabilities;
+	std::unordered_map<type_lookup, spv::Id, type_lookup::hash> _type_lookup;
+	std::unordered_map<constant_lookup, spv::Id, constant_lookup::hash> _constant_lookup;
+	std::unordered_map<function_type_lookup, spv::Id, function_type_lookup::hash> _function_type_lookup;
+	std::unordered_map<std::string, spv::Id> _string_lookup;
+	std::unordered_map<spv::Id, spv::StorageClass> _storage_lookup;
+	std::unordered_map<std::string, uint32_t> _semantic_to_location;
+
+	std::vector<function_blocks> _functions_blocks;
+	std::unordered_map<id, spirv_basic_block> _block_data;
+	spirv_basic_block *_current_block_data = nullptr;
+
+	bool _debug_info = false;
+	bool _vulkan_semantics = false;
+	bool _uniforms_to_spec_constants = false;
+	bool _enable_16bit_types = false;
+	bool _flip_vert_y = false;
+	bool _optimize = false;
+	id _glsl_ext = 0;
+	id _global_ubo_type = 0;
+	id _global_ubo_variable = 0;
+	std::vector<spv::Id> _global_ubo_types;
+	function_blocks *_current_function = nullptr;
+
+	inline void add_location(const location &loc, spirv_basic_block &block)
+	{
+		if (loc.source.empty() || !_debug_info)
+			return;
+
+		spv::Id file;
+		if (const auto it = _string_lookup.find(loc.source);
+			it != _string_lookup.end())
+		{
+			file = it->second;
+		}
+		else
+		{
+			add_instruction(spv::OpString, 0, _debug_a, file)
+				.add_string(loc.source.c_str());
+			_string_lookup.emplace(loc.source, file);
+		}
+
+		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpLine
+		add_instruction_without_result(spv::OpLine, block)
+			.add(file)
+			.add(loc.line)
+			.add(loc.column);
+	}
+	inline spirv_instruction &add_instruction(spv::Op op, spv::Id type = 0)
+	{
+		assert(is_in_function() && is_in_block());
+		return add_instruction(op, type, *_current_block_data);
+	}
+	inline spirv_instruction &add_instruction(spv::Op op, spv::Id type, spirv_basic_block &block)
+	{
+		spirv_instruction &instruction = add_instruction_without_result(op, block);
+		instruction.type = type;
+		instruction.result = make_id();
+		return instruction;
+	}
+	inline spirv_instruction &add_instruction(spv::Op op, spv::Id type, spirv_basic_block &block, spv::Id &result)
+	{
+		spirv_instruction &instruction = add_instruction_without_result(op, block);
+		instruction.type = type;
+		instruction.result = result = make_id();
+		return instruction;
+	}
+	inline spirv_instruction &add_instruction_without_result(spv::Op op)
+	{
+		assert(is_in_function() && is_in_block());
+		return add_instruction_without_result(op, *_current_block_data);
+	}
+	inline spirv_instruction &add_instruction_without_result(spv::Op op, spirv_basic_block &block)
+	{
+		return block.instructions.emplace_back(op, &_memory);
+	}
+
+	void write_result(module &module) override
+	{
+		// First initialize the UBO type now that all member types are known
+		if (_global_ubo_type != 0)
+		{
+			spirv_instruction &type_inst = add_instruction_without_result(spv::OpTypeStruct, _types_and_constants);
+			type_inst.add(_global_ubo_types.begin(), _global_ubo_types.end());
+			type_inst.result = _global_ubo_type;
+
+			spirv_instruction &variable_inst = add_instruction_without_result(spv::OpVariable, _variables);
+			variable_inst.add(spv::StorageClassUniform);
+			variable_inst.type = convert_type({ type::t_struct, 0, 0, type::q_uniform, 0, _global_ubo_type }, true, spv::StorageClassUniform);
+			variable_inst.result = _global_ubo_variable;
+
+			add_name(variable_inst.result, "$Globals");
+		}
+
+		if (_optimize)
+			optimize();
+
+		module = std::move(_module);
+
+		write_module(module.spirv, nullptr);
+
+		// There are various issues with SPIR-V modules that have multiple entry points on all major GPU vendors.
+		// On AMD for instance creating a graphics pipeline just fails with a generic VK_ERROR_OUT_OF_HOST_MEMORY. On NVIDIA artifacts occur on some driver versions.
+		// To work around these problems, also write a separate module for every entry point, which only contains that entry point and the functions and variables it references.
+		for (const spirv_instruction &entry_inst : _entries.instructions)
+			for (entry_point &entry_point : module.entry_points)
+				if (entry_point.name == reinterpret_cast<const char *>(entry_inst.operands.data() + 2))
+					write_module(entry_point.spirv, &entry_inst);
+	}
+
+	/// <summary>
+	/// Writes the SPIR-V binary for the module.
+	/// </summary>
+	/// <param name="spirv">The output stream to write the binary to.</param>
+	/// <param name="entry_inst">The entry point instruction to limit the binary to, or <see langword="nullptr"/> to write the module with all entry points.</param>
+	void write_module(std::vector<uint32_t> &spirv, const spirv_instruction *entry_inst) const
+	{
+		std::unordered_set<spv::Id> referenced;
+		if (entry_inst != nullptr)
+			collect_referenced_ids(*entry_inst, referenced);
+
+		// Instructions defining an ID that is not referenced by the entry point are skipped, as are names and decorations targeting those IDs
+		const auto is_referenced = [entry_inst, &referenced](const spirv_instruction &inst) {
+			if (entry_inst == nullptr)
+				return true;
+
+			switch (inst.op)
+			{
+			case spv::OpEntryPoint:
+				return &inst == entry_inst;
+			case spv::OpLine:
+			case spv::OpExecutionMode:
+			case spv::OpName:
+			case spv::OpMemberName:
+			case spv::OpDecorate:
+			case spv::OpMemberDecorate:
+				return referenced.find(inst.operands[0]) != referenced.end();
+			default:
+				return inst.result == 0 || referenced.find(inst.result) != referenced.end();
+			}
+		};
+
+		// Write SPIRV header info
+		spirv.push_back(spv::MagicNumber);
+		spirv.push_back(0x10300); // Force SPIR-V 1.3
+		spirv.push_back(0u); // Generator magic number, see https://www.khronos.org/registry/spir-v/api/spir-v.xml
+		spirv.push_back(_next_id); // Maximum ID
+		spirv.push_back(0u); // Reserved for instruction schema
+
+		// All capabilities
+		spirv_instruction(spv::OpCapability, &_memory)
+			.add(spv::CapabilityShader) // Implicitly declares the Matrix capability too
+			.write(spirv);
+
+		for (spv::Capability capability : _capabilities)
+			spirv_instruction(spv::OpCapability, &_memory)
+				.add(capability)
+				.write(spirv);
+
+		// Optional extension instructions
+		{	spirv_instruction import_inst(spv::OpExtInstImport, &_memory);
+			import_inst.result = _glsl_ext;
+			import_inst
+				.add_string("GLSL.std.450") // Import GLSL extension
+				.write(spirv);
+		}
+
+		// Single required memory model instruction
+		spirv_instruction(spv::OpMemoryModel, &_memory)
+			.add(spv::AddressingModelLogical)
+			.add(spv::MemoryModelGLSL450)
+			.write(spirv);
+
+		// All entry point declarations
+		for (const auto &node : _entries.instructions)
+			if (is_referenced(node))
+				node.write(spirv);
+
+		// All execution mode declarations
+		for (const auto &node : _execution_modes.instructions)
+			if (is_referenced(node))
+				node.write(spirv);
+
+		spirv_instruction(spv::OpSource, &_memory)
+			.add(spv::SourceLanguageUnknown) // ReShade FX is not a reserved token at the moment
+			.add(0) // Language version, TODO: Maybe fill in ReShade version here?
+			.write(spirv);
+
+		if (_debug_info)
+		{
+			// All debug instructions
+			for (const auto &node : _debug_a.instructions)
+				if (is_referenced(node))
+					node.write(spirv);
+			for (const auto &node : _debug_b.instructions)
+				if (is_referenced(node))
+					node.write(spirv);
+		}
+
+		// All annotation instructions
+		for (const auto &node : _annotations.instructions)
+			if (is_referenced(node))
+				node.write(spirv);
+
+		// All type declarations
+		for (const auto &node : _types_and_constants.instructions)
+			if (is_referenced(node))
+				node.write(spirv);
+		for (const auto &node : _variables.instructions)
+			if (is_referenced(node))
+				node.write(spirv);
+
+		// All function definitions
+		for (const auto &function : _functions_blocks)
+		{
+			if (function.definition.instructions.empty())
+				continue;
+
+			if (entry_inst != nullptr)
+			{
+				const auto function_inst = std::find_if(function.declaration.instructions.begin(), function.declaration.instructions.end(),
+					[](const spirv_instruction &inst) { return inst.op == spv::OpFunction; });
+				if (function_inst == function.declaration.instructions.end() || !is_referenced(*function_inst))
+					continue;
+			}
+
+			for (const auto &node : function.declaration.instructions)
+				node.write(spirv);
+
+			// Grab first label and move it in front of variable declarations
+			function.definition.instructions.front().write(spirv);
+			assert(function.definition.instructions.front().op == spv::OpLabel);
+
+			for (const auto &node : function.variables.instructions)
+				node.write(spirv);
+			for (auto it = function.definition.instructions.begin() + 1; it != function.definition.instructions.end(); ++it)
+				it->write(spirv);
+		}
+	}
+
+	/// <summary>
+	/// Collects all IDs that are referenced by an entry point, which includes the functions it calls and all types, constants and variables used by those.
+	/// </summary>
+	void collect_referenced_ids(const spirv_instruction &entry_inst, std::unordered_set<spv::Id> &referenced) const
+	{
+		std::unordered_map<spv::Id, const spirv_instruction *> global_definitions;
+		for (const spirv_basic_block *block : { &_debug_a, &_types_and_constants, &_variables })
+			for (const spirv_instruction &inst : block->instructions)
+				if (inst.result != 0)
+					global_definitions.emplace(inst.result, &inst);
+
+		std::unordered_map<spv::Id, const function_blocks *> function_definitions;
+		for (const function_blocks &function : _functions_blocks)
+			for (const spirv_instruction &inst : function.declaration.instructions)
+				if (inst.op == spv::OpFunction)
+					function_definitions.emplace(inst.result, &function);
+
+		std::vector<spv::Id> worklist;
+		const auto add_reference = [&referenced, &worklist](spv::Id id) {
+			if (id != 0 && referenced.insert(id).second)
+				worklist.push_back(id);
+		};
+
+		// Function and interface variables of the entry point
+		for_each_id_operand(entry_inst, add_reference);
+
+		while (!worklist.empty())
+		{
+			const spv::Id id = worklist.back();
+			worklist.pop_back();
+
+			if (const auto it = global_definitions.find(id); it != global_definitions.end())
+			{
+				add_reference(it->second->type);
+				for_each_id_operand(*it->second, add_reference);
+			}
+			else if (const auto function_it = function_definitions.find(id); function_it != function_definitions.end())
+			{
+				for (const spirv_basic_block *block : { &function_it->second->declaration, &function_it->second->variables, &function_it->second->definition })
+				{
+					for (const spirv_instruction &inst : block->instructions)
+					{
+						add_reference(inst.type);
+						for_each_id_operand(inst, add_reference);
+					}
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Information about the module gathered for the optimization passes.
+	/// </summary>
+	struct optimization_info
+	{
+		struct scalar_type
+		{
+			spv::Op op;
+			uint32_t width;
+		};
+
+		// Pointee type of every pointer type
+		std::unordered_map<spv::Id, spv::Id> pointee_types;
+		// Component type and number of components of every scalar and vector type (scalar types are their own component type)
+		std::unordered_map<spv::Id, std::pair<spv::Id, uint32_t>> vector_types;
+		std::unordered_map<spv::Id, scalar_type> scalar_types;
+		// Type and value of all scalar constants and type and components of all composite constants (specialization constants are not included, since their value is not known yet)
+		std::unordered_map<spv::Id, std::pair<spv::Id, uint32_t>> scalar_constants;
+		std::unordered_map<spv::Id, std::pair<spv::Id, std::vector<spv::Id>>> composite_constants;
+		std::map<std::pair<spv::Id, uint32_t>, spv::Id> scalar_constant_lookup;
+		std::map<std::pair<spv::Id, std::vector<spv::Id>>, spv::Id> composite_constant_lookup;
+		std::unordered_map<spv::Id, spv::Id> undef_lookup;
+		std::unordered_map<spv::Id, size_t> function_lookup;
+		// Number of call sites of every function (before inlining)
+		std::vector<size_t> function_call_counts;
+		// Indices of the decoration and name instructions in the annotation and debug sections targeting a specific ID
+		std::unordered_multimap<spv::Id, size_t> decoration_lookup;
+		std::unordered_multimap<spv::Id, size_t> name_lookup;
+	};
+
+	/// <summary>
+	/// Calls the specified function for every operand of an instruction that references an ID (skipping literal operands).
+	/// </summary>
+	template <typename T, typename F>
+	static void for_each_id_operand(T &inst, F func)
+	{
+		// Number of operands at the start of the instruction that are IDs, all operands following them are literals (unless handled separately below)
+		size_t num_ids = inst.operands.size();
+
+		switch (inst.op)
+		{
+		case spv::OpEntryPoint: // Execution model, function, name, interface variables
+			func(inst.operands[1]);
+			for (size_t i = 2; i < inst.operands.size(); ++i)
+			{
+				// Skip over the name string, which ends with the first word that has a null character in its last byte
+				if ((inst.operands[i] & 0xFF000000) != 0)
+					continue;
+				for (++i; i < inst.operands.size(); ++i)
+					func(inst.operands[i]);
+			}
+			return;
+		case spv::OpTypePointer: // Storage class, type
+			func(inst.operands[1]);
+			return;
+		case spv::OpString:
+		case spv::OpTypeInt:
+		case spv::OpTypeFloat:
+		case spv::OpConstant:
+		case spv::OpSpecConstant:
+			return;
+		case spv::OpVariable: // Storage class, optional initializer
+			for (size_t i = 1; i < inst.operands.size(); ++i)
+				func(inst.operands[i]);
+			return;
+		case spv::OpExtInst: // Set, instruction, operands
+			func(inst.operands[0]);
+			for (size_t i = 2; i < inst.operands.size(); ++i)
+				func(inst.operands[i]);
+			return;
+		case spv::OpSwitch: // Selector, default target, pairs of literals and targets
+			func(inst.operands[0]);
+			func(inst.operands[1]);
+			for (size_t i = 3; i < inst.operands.size(); i += 2)
+				func(inst.operands[i]);
+			return;
+		case spv::OpImageSampleImplicitLod:
+		case spv::OpImageSampleExplicitLod:
+		case spv::OpImageFetch:
+		case spv::OpImageGather:
+		case spv::OpImageWrite:
+			// Image operands mask between the fixed operands and the optional operands
+			for (size_t i = 0, mask_index = (inst.op == spv::OpImageGather || inst.op == spv::OpImageWrite) ? 3 : 2; i < inst.operands.size(); ++i)
+				if (i != mask_index)
+					func(inst.operands[i]);
+			return;
+		case spv::OpLine:
+		case spv::OpName:
+		case spv::OpMemberName:
+		case spv::OpDecorate:
+		case spv::OpMemberDecorate:
+		case spv::OpExecutionMode:
+		case spv::OpTypeVector:
+		case spv::OpTypeMatrix:
+		case spv::OpTypeImage:
+		case spv::OpLoad:
+		case spv::OpCompositeExtract:
+		case spv::OpSelectionMerge:
+			num_ids = 1;
+			break;
+		case spv::OpStore:
+		case spv::OpCompositeInsert:
+		case spv::OpVectorShuffle:
+		case spv::OpLoopMerge:
+			num_ids = 2;
+			break;
+		case spv::OpBranchConditional:
+			num_ids = 3;
+			break;
+		default:
+			break;
+		}
+
+		for (size_t i = 0; i < std::min(num_ids, inst.operands.size()); ++i)
+			func(inst.operands[i]);
+	}
+	/// <summary>
+	/// Calls the specified function for every block the terminator instruction at the end of a block can branch to.
+	/// </summary>
+	template <typename F>
+	static void for_each_successor(const spirv_basic_block &block, F func)
+	{
+		const spirv_instruction &inst = block.instructions.back();
+
+		switch (inst.op)
+		{
+		case spv::OpBranch:
+			func(inst.operands[0]);
+			break;
+		case spv::OpBranchConditional:
+			func(inst.operands[1]);
+			if (inst.operands[2] != inst.operands[1])
+				func(inst.operands[2]);
+			break;
+		case spv::OpSwitch:
+			func(inst.operands[1]);
+			for (size_t i = 3; i < inst.operands.size(); i += 2)
+				if (inst.operands[i] != inst.operands[1] && std::find(inst.operands.begin() + 3, inst.operands.begin() + i, inst.operands[i]) == inst.operands.begin() + i)
+					func(inst.operands[i]);
+			break;
+		default:
+			break;
+		}
+	}
+
+	spv::Id get_undef(optimization_info &info, spv::Id type)
+	{
+		if (const auto it = info.undef_lookup.find(type); it != info.undef_lookup.end())
+			return it->second;
+
+		const spv::Id result = add_instruction(spv::OpUndef, type, _types_and_constants).result;
+		info.undef_lookup.emplace(type, result);
+		return result;
+	}
+	spv::Id get_scalar_constant(optimization_info &info, spv::Id type, uint32_t value)
+	{
+		if (info.scalar_types.at(type).op == spv::OpTypeBool)
+			value = value != 0;
+
+		if (const auto it = info.scalar_constant_lookup.find({ type, value }); it != info.scalar_constant_lookup.end())
+			return it->second;
+
+		spv::Id result;
+		if (info.scalar_types.at(type).op == spv::OpTypeBool)
+			add_instruction(value ? spv::OpConstantTrue : spv::OpConstantFalse, type, _types_and_constants, result);
+		else
+			add_instruction(spv::OpConstant, type, _types_and_constants, result)
+				.add(value);
+
+		info.scalar_constants.emplace(result, std::make_pair(type, value));
+		info.scalar_constant_lookup.emplace(std::make_pair(type, value), result);
+		return result;
+	}
+	spv::Id get_composite_constant(optimization_info &info, spv::Id type, std::vector<spv::Id> components)
+	{
+		if (const auto it = info.composite_constant_lookup.find({ type, components }); it != info.composite_constant_lookup.end())
+			return it->second;
+
+		spv::Id result;
+		add_instruction(spv::OpConstantComposite, type, _types_and_constants, result)
+			.add(components.begin(), components.end());
+
+		info.composite_constants.emplace(result, std::make_pair(type, components));
+		info.composite_constant_lookup.emplace(std::make_pair(type, std::move(components)), result);
+		return result;
+	}
+
+	/// <summary>
+	/// Runs a set of optimization passes over all functions in the module: Function inlining, promotion of local variables to SSA values, constant folding and dead code elimination.
+	/// This reduces the amount of work drivers have to do when creating pipelines and works around some driver issues with complex shaders.
+	/// </summary>
+	void optimize()
+	{
+		optimization_info info;
+
+		for (const spirv_instruction &inst : _types_and_constants.instructions)
+		{
+			switch (inst.op)
+			{
+			case spv::OpTypePointer:
+				info.pointee_types.emplace(inst.result, inst.operands[1]);
+				break;
+			case spv::OpTypeBool:
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+				info.scalar_types.emplace(inst.result, optimization_info::scalar_type { inst.op, inst.op == spv::OpTypeBool ? 32 : inst.operands[0] });
+				info.vector_types.emplace(inst.result, std::make_pair(inst.result, 1u));
+				break;
+			case spv::OpTypeVector:
+				info.vector_types.emplace(inst.result, std::make_pair(inst.operands[0], inst.operands[1]));
+				break;
+			case spv::OpConstantTrue:
+			case spv::OpConstantFalse:
+			case spv::OpConstant:
+				if (inst.op == spv::OpConstant && inst.operands.size() != 1)
+					break; // Ignore 64-bit constants
+				info.scalar_constants.emplace(inst.result, std::make_pair(inst.type, inst.op == spv::OpConstant ? inst.operands[0] : inst.op == spv::OpConstantTrue));
+				info.scalar_constant_lookup.emplace(std::make_pair(inst.type, inst.op == spv::OpConstant ? inst.operands[0] : inst.op == spv::OpConstantTrue), inst.result);
+				break;
+			case spv::OpConstantComposite:
+				info.composite_constants.emplace(inst.result, std::make_pair(inst.type, std::vector<spv::Id>(inst.operands.begin(), inst.operands.end())));
+				info.composite_constant_lookup.emplace(std::make_pair(inst.type, std::vector<spv::Id>(inst.operands.begin(), inst.operands.end())), inst.result);
+				break;
+			default:
+				break;
+			}
+		}
+
+		for (size_t i = 0; i < _annotations.instructions.size(); ++i)
+			if (_annotations.instructions[i].op == spv::OpDecorate)
+				info.decoration_lookup.emplace(_annotations.instructions[i].operands[0], i);
+		for (size_t i = 0; i < _debug_b.instructions.size(); ++i)
+			if (_debug_b.instructions[i].op == spv::OpName)
+				info.name_lookup.emplace(_debug_b.instructions[i].operands[0], i);
+
+		// Split all function definitions into their basic blocks
+		std::vector<std::vector<spirv_basic_block>> blocks(_functions_blocks.size());
+
+		for (size_t function_index = 0; function_index < _functions_blocks.size(); ++function_index)
+		{
+			const function_blocks &function = _functions_blocks[function_index];
+
+			for (const spirv_instruction &inst : function.declaration.instructions)
+				if (inst.op == spv::OpFunction)
+					info.function_lookup.emplace(inst.result, function_index);
+
+			for (const spirv_instruction &inst : function.definition.instructions)
+			{
+				if (inst.op == spv::OpFunctionEnd)
+					break;
+				if (inst.op == spv::OpLabel || blocks[function_index].empty())
+					blocks[function_index].emplace_back();
+
+				blocks[function_index].back().instructions.push_back(inst);
+			}
+
+			if (!blocks[function_index].empty())
+				remove_unreachable_blocks(info, blocks[function_index]);
+		}
+
+		{	// Inline callees before their callers, so that the inlined code is already optimized as far as possible
+			info.function_call_counts.resize(_functions_blocks.size());
+			for (const std::vector<spirv_basic_block> &function_blocks : blocks)
+				for (const spirv_basic_block &block : function_blocks)
+					for (const spirv_instruction &inst : block.instructions)
+						if (inst.op == spv::OpFunctionCall)
+							if (const auto callee = info.function_lookup.find(inst.operands[0]); callee != info.function_lookup.end())
+								info.function_call_counts[callee->second]++;
+
+			std::vector<uint8_t> inline_state(_functions_blocks.size());
+			for (size_t function_index = 0; function_index < _functions_blocks.size(); ++function_index)
+				inline_function_calls(info, blocks, function_index, inline_state);
+		}
+
+		for (size_t function_index = 0; function_index < _functions_blocks.size(); ++function_index)
+		{
+			function_blocks &function = _functions_blocks[function_index];
+			if (blocks[function_index].empty())
+				continue;
+
+			remove_unreachable_blocks(info, blocks[function_index]);
+			promote_local_variables(info, function, blocks[function_index]);
+
+			// Folding may turn further values and branch conditions into constants, so repeat it a few times
+			for (int iteration = 0; iteration < 4 && fold_constants(info, blocks[function_index]); ++iteration)
+				remove_unreachable_blocks(info, blocks[function_index]);
+
+			eliminate_dead_code(function, blocks[function_index]);
+
+			// Put the function definition back together
+			function.definition.instructions.clear();
+			for (const spirv_basic_block &block : blocks[function_index])
+				function.definition.append(block);
+			add_instruction_without_result(spv::OpFunctionEnd, function.definition);
+		}
+
+		remove_unused_functions_and_variables(info);
+	}
+
+	/// <summary>
+	/// Removes all blocks that can never be executed. Blocks that are still referenced by structured control flow instructions are kept, but their contents replaced.
+	/// </summary>
+	void remove_unreachable_blocks(optimization_info &info, std::vector<spirv_basic_block> &blocks)
+	{
+		std::unordered_map<spv::Id, size_t> block_lookup;
+		for (size_t block_index = 0; block_index < blocks.size(); ++block_index)
+			block_lookup.emplace(blocks[block_index].instructions[0].result, block_index);
+
+		std::vector<bool> reachable(blocks.size());
+		std::vector<size_t> worklist = { 0 };
+		reachable[0] = true;
+
+		while (!worklist.empty())
+		{
+			const size_t block_index = worklist.back();
+			worklist.pop_back();
+
+			for_each_successor(blocks[block_index], [&](spv::Id target) {
+				if (const size_t target_index = block_lookup.at(target); !reachable[target_index])
+				{
+					reachable[target_index] = true;
+					worklist.push_back(target_index);
+				}
+			});
+		}
+
+		if (std::find(reachable.begin(), reachable.end(), false) == reachable.end())
+			return;
+
+		// Merge blocks and continue targets of the remaining constructs need to stay, so map them to zero and to their loop header respectively
+		std::unordered_map<spv::Id, spv::Id> referenced_blocks;
+		for (size_t block_index = 0; block_index < blocks.size(); ++block_index)
+		{
+			if (!reachable[block_index])
+				continue;
+
+			for (const spirv_instruction &inst : blocks[block_index].instructions)
+			{
+				if (inst.op == spv::OpSelectionMerge)
+					referenced_blocks.emplace(inst.operands[0], 0);
+				if (inst.op == spv::OpLoopMerge)
+				{
+					referenced_blocks.emplace(inst.operands[0], 0);
+					referenced_blocks[inst.operands[1]] = blocks[block_index].instructions[0].result;
+				}
+			}
+		}
+
+		std::unordered_set<spv::Id> stub_blocks;
+
+		for (size_t block_index = 0, k = 0; k < reachable.size(); ++k)
+		{
+			if (!reachable[k])
+			{
+				const auto it = referenced_blocks.find(blocks[block_index].instructions[0].result);
+				if (it == referenced_blocks.end())
+				{
+					blocks.erase(blocks.begin() + block_index);
+					continue;
+				}
+
+				std::vector<spirv_instruction> &instructions = blocks[block_index].instructions;
+				instructions.erase(instructions.begin() + 1, instructions.end());
+
+				// A continue target has to branch back to the loop header, everything else can just be marked unreachable
+				if (it->second != 0)
+					add_instruction_without_result(spv::OpBranch, blocks[block_index])
+						.add(it->second);
+				else
+					add_instruction_without_result(spv::OpUnreachable, blocks[block_index]);
+
+				stub_blocks.insert(it->first);
+			}
+
+			block_index++;
+		}
+
+		update_phi_operands(info, blocks);
+
+		// Values coming from blocks whose contents were removed are no longer defined
+		for (spirv_basic_block &block : blocks)
+			for (spirv_instruction &inst : block.instructions)
+				if (inst.op == spv::OpPhi)
+					for (size_t i = 0; i < inst.operands.size(); i += 2)
+						if (stub_blocks.find(inst.operands[i + 1]) != stub_blocks.end())
+							inst.operands[i] = get_undef(info, inst.type);
+	}
+
+	/// <summary>
+	/// Updates the operands of all phi instructions to match the current predecessors of their block.
+	/// </summary>
+	void update_phi_operands(optimization_info &info, std::vector<spirv_basic_block> &blocks)
+	{
+		std::unordered_map<spv::Id, std::vector<spv::Id>> predecessors;
+		for (const spirv_basic_block &block : blocks)
+			for_each_successor(block, [&](spv::Id target) { predecessors[target].push_back(block.instructions[0].result); });
+
+		for (spirv_basic_block &block : blocks)
+		{
+			const std::vector<spv::Id> &block_predecessors = predecessors[block.instructions[0].result];
+
+			for (spirv_instruction &inst : block.instructions)
+			{
+				if (inst.op != spv::OpPhi)
+					continue;
+
+				for (size_t i = 0; i < inst.operands.size();)
+				{
+					if (std::find(block_predecessors.begin(), block_predecessors.end(), inst.operands[i + 1]) == block_predecessors.end())
+						inst.operands.erase(inst.operands.begin() + i, inst.operands.begin() + i + 2);
+					else
+						i += 2;
+				}
+
+				for (const spv::Id predecessor : block_predecessors)
+				{
+					bool found = false;
+					for (size_t i = 0; i < inst.operands.size() && !found; i += 2)
+						found = inst.operands[i + 1] == predecessor;
+
+					if (!found)
+						inst.add(get_undef(info, inst.type))
+							.add(predecessor);
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Inlines all calls to functions that have a single return statement at their end into the specified function.
+	/// Large functions are only inlined if they are called just once, to avoid blowing up the code size by duplicating them at every call site.
+	/// </summary>
+	void inline_function_calls(optimization_info &info, std::vector<std::vector<spirv_basic_block>> &blocks, size_t function_index, std::vector<uint8_t> &state)
+	{
+		// Maximum number of instructions in a function that is called more than once for it to still be inlined
+		constexpr size_t max_inline_instructions = 32;
+
+		if (state[function_index] != 0)
+			return; // Already processed (or currently being processed, which would indicate recursion)
+		state[function_index] = 1;
+
+		for (size_t block_index = 0; block_index < blocks[function_index].size(); ++block_index)
+		{
+			const std::vector<spirv_instruction> &instructions = blocks[function_index][block_index].instructions;
+
+			// Loop headers cannot be split, since the loop merge instruction has to stay in the block the back edge branches to
+			if (std::find_if(instructions.begin(), instructions.end(), [](const spirv_instruction &inst) { return inst.op == spv::OpLoopMerge; }) != instructions.end())
+				continue;
+
+			for (size_t inst_index = 0; inst_index < instructions.size(); ++inst_index)
+			{
+				if (instructions[inst_index].op != spv::OpFunctionCall)
+					continue;
+
+				const auto callee = info.function_lookup.find(instructions[inst_index].operands[0]);
+				if (callee == info.function_lookup.end())
+					continue;
+
+				inline_function_calls(info, blocks, callee->second, state);
+
+				if (state[callee->second] != 2 || !can_inline_function(blocks[callee->second]) ||
+					(info.function_call_counts[callee->second] > 1 && count_instructions(blocks[callee->second]) > max_inline_instructions))
+					continue;
+
+				inline_function_call(info, _functions_blocks[function_index], blocks[function_index], block_index, inst_index, _functions_blocks[callee->second], blocks[callee->second]);
+
+				// The rest of this block was moved into a new block after the inlined code, which is processed in a later iteration
+				break;
+			}
+		}
+
+		state[function_index] = 2;
+	}
+	static size_t count_instructions(const std::vector<spirv_basic_block> &blocks)
+	{
+		size_t num_instructions = 0;
+		for (const spirv_basic_block &block : blocks)
+			num_instructions += block.instructions.size();
+		return num_instructions;
+	}
+	static bool can_inline_function(const std::vector<spirv_basic_block> &blocks)
+	{
+		if (blocks.empty())
+			return false;
+
+		// Only functions with a single return at the very end can be inlined without having to restructure the control flow
+		size_t num_returns = 0;
+		for (const spirv_basic_block &block : blocks)
+			num_returns += std::count_if(block.instructions.begin(), block.instructions.end(),
+				[](const spirv_instruction &inst) { return inst.op == spv::OpReturn || inst.op == spv::OpReturnValue; });
+
+		const spv::Op last_op = blocks.back().instructions.back().op;
+		return num_returns == 1 && (last_op == spv::OpReturn || last_op == spv::OpReturnValue);
+	}
+	void inline_function_call(optimization_info &info, function_blocks &caller, std::vector<spirv_basic_block> &blocks, size_t block_index, size_t inst_index, const function_blocks &callee, const std::vector<spirv_basic_block> &callee_blocks)
+	{
+		const spirv_instruction call = blocks[block_index].instructions[inst_index];
+		const spv::Id call_block_label = blocks[block_index].instructions[0].result;
+
+		std::unordered_map<spv::Id, spv::Id> id_map;
+
+		// Parameters are replaced with the arguments of the call
+		for (const spirv_instruction &inst : callee.declaration.instructions)
+			if (inst.op == spv::OpFunctionParameter)
+				id_map.emplace(inst.result, call.operands[1 + id_map.size()]);
+
+		// All local variables and results in the callee are assigned new IDs
+		std::vector<std::pair<spv::Id, spv::Id>> new_ids;
+		const auto map_result = [this, &id_map, &new_ids](const spirv_instruction &inst) {
+			if (inst.result != 0)
+				new_ids.emplace_back(inst.result, id_map[inst.result] = make_id());
+		};
+
+		for (const spirv_instruction &inst : callee.variables.instructions)
+			map_result(inst);
+		for (const spirv_basic_block &block : callee_blocks)
+			for (const spirv_instruction &inst : block.instructions)
+				map_result(inst);
+
+		const auto remap = [&id_map](spirv_instruction &inst) {
+			if (inst.result != 0)
+				inst.result = id_map.at(inst.result);
+			for_each_id_operand(inst, [&id_map](spv::Id &id) {
+				if (const auto it = id_map.find(id); it != id_map.end())
+					id = it->second;
+			});
+		};
+
+		for (spirv_instruction inst : callee.variables.instructions)
+		{
+			remap(inst);
+			caller.variables.instructions.push_back(std::move(inst));
+		}
+
+		std::vector<spirv_basic_block> inlined_blocks(callee_blocks);
+		for (spirv_basic_block &block : inlined_blocks)
+			for (spirv_instruction &inst : block.instructions)
+				remap(inst);
+
+		// Replace the return at the end of the callee with a branch to the code following the call
+		spirv_basic_block continue_block;
+		add_instruction_without_result(spv::OpLabel, continue_block)
+			.result = make_id();
+
+		spirv_instruction &return_inst = inlined_blocks.back().instructions.back();
+		if (return_inst.op == spv::OpReturnValue)
+		{
+			spirv_instruction &copy_inst = add_instruction_without_result(spv::OpCopyObject, continue_block);
+			copy_inst.type = call.type;
+			copy_inst.result = call.result;
+			copy_inst.add(return_inst.operands[0]);
+		}
+
+		return_inst.op = spv::OpBranch;
+		return_inst.operands.clear();
+		return_inst.add(continue_block.instructions[0].result);
+
+		// Split the calling block in two and branch to the inlined code in between
+		std::vector<spirv_instruction> &instructions = blocks[block_index].instructions;
+		continue_block.instructions.insert(continue_block.instructions.end(), instructions.begin() + inst_index + 1, instructions.end());
+		instructions.erase(instructions.begin() + inst_index, instructions.end());
+		add_instruction_without_result(spv::OpBranch, blocks[block_index])
+			.add(inlined_blocks[0].instructions[0].result);
+
+		// Successors of the calling block are now branched to from the new block after the inlined code
+		for (spirv_basic_block &block : blocks)
+			for (spirv_instruction &inst : block.instructions)
+				if (inst.op == spv::OpPhi)
+					for (size_t i = 1; i < inst.operands.size(); i += 2)
+						if (inst.operands[i] == call_block_label)
+							inst.operands[i] = continue_block.instructions[0].result;
+
+		inlined_blocks.push_back(std::move(continue_block));
+		blocks.insert(blocks.begin() + block_index + 1, std::make_move_iterator(inlined_blocks.begin()), std::make_move_iterator(inlined_blocks.end()));
+
+		// Duplicate decorations and names of the callee results for the new IDs
+		for (const auto &[old_id, new_id] : new_ids)
+		{
+			std::vector<size_t> decorations, names;
+			for (auto [it, end] = info.decoration_lookup.equal_range(old_id); it != end; ++it)
+				decorations.push_back(it->second);
+			for (auto [it, end] = info.name_lookup.equal_range(old_id); it != end; ++it)
+				names.push_back(it->second);
+
+			for (const size_t index : decorations)
+			{
+				spirv_instruction inst = _annotations.instructions[index];
+				inst.operands[0] = new_id;
+				info.decoration_lookup.emplace(new_id, _annotations.instructions.size());
+				_annotations.instructions.push_back(std::move(inst));
+			}
+			for (const size_t index : names)
+			{
+				spirv_instruction inst = _debug_b.instructions[index];
+				inst.operands[0] = new_id;
+				info.name_lookup.emplace(new_id, _debug_b.instructions.size());
+				_debug_b.instructions.push_back(std::move(inst));
+			}
+		}
+	}
+
+	/// <summary>
+	/// Replaces local variables that are only ever loaded from and stored to with SSA values (inserting phi instructions where control flow merges).
+	/// </summary>
+	void promote_local_variables(optimization_info &info, function_blocks &function, std::vector<spirv_basic_block> &blocks)
+	{
+		// Find all local variables that are only accessed through loads and stores (either directly or through access chains with constant indices)
+		std::unordered_map<spv::Id, spv::Id> variable_types;
+		for (const spirv_instruction &inst : function.variables.instructions)
+			if (inst.op == spv::OpVariable && inst.operands.size() == 1)
+				variable_types.emplace(inst.result, info.pointee_types.at(inst.type));
+
+		// Base variable followed by the literal indices of every access chain into one of those variables
+		std::unordered_map<spv::Id, std::vector<uint32_t>> access_chains;
+		for (const spirv_basic_block &block : blocks)
+		{
+			for (const spirv_instruction &inst : block.instructions)
+			{
+				if (inst.op != spv::OpAccessChain || variable_types.find(inst.operands[0]) == variable_types.end() ||
+					!std::all_of(inst.operands.begin() + 1, inst.operands.end(), [&info](spv::Id index) { return info.scalar_constants.find(index) != info.scalar_constants.end(); }))
+					continue;
+
+				std::vector<uint32_t> &access_chain = access_chains[inst.result];
+				access_chain.push_back(inst.operands[0]);
+				for (size_t i = 1; i < inst.operands.size(); ++i)
+					access_chain.push_back(info.scalar_constants.at(inst.operands[i]).second);
+			}
+		}
+
+		for (spirv_basic_block &block : blocks)
+		{
+			for (spirv_instruction &inst : block.instructions)
+			{
+				for_each_id_operand(inst, [&](spv::Id &id) {
+					const size_t operand_index = &id - inst.operands.data();
+					if ((inst.op == spv::OpLoad || inst.op == spv::OpStore) && operand_index == 0)
+						return;
+					if (inst.op == spv::OpAccessChain && operand_index == 0 && access_chains.find(inst.result) != access_chains.end())
+						return;
+
+					// Any other use disqualifies the variable
+					if (const auto it = access_chains.find(id); it != access_chains.end())
+						variable_types.erase(it->second[0]);
+					variable_types.erase(id);
+				});
+			}
+		}
+
+		if (variable_types.empty())
+			return;
+
+		// Turn accesses through access chains into loads and stores of the entire variable, extracting or inserting the accessed element
+		for (spirv_basic_block &block : blocks)
+		{
+			std::vector<spirv_instruction> instructions;
+			instructions.reserve(block.instructions.size());
+
+			for (spirv_instruction &inst : block.instructions)
+			{
+				const std::vector<uint32_t> *access_chain = nullptr;
+				if (inst.op == spv::OpLoad || inst.op == spv::OpStore)
+					if (const auto it = access_chains.find(inst.operands[0]); it != access_chains.end() && variable_types.find(it->second[0]) != variable_types.end())
+						access_chain = &it->second;
+
+				if (access_chain == nullptr)
+				{
+					if (inst.op != spv::OpAccessChain || access_chains.find(inst.result) == access_chains.end() || variable_types.find(inst.operands[0]) == variable_types.end())
+						instructions.push_back(std::move(inst));
+					continue;
+				}
+
+				const spv::Id variable = (*access_chain)[0];
+				const spv::Id variable_type = variable_types.at(variable);
+
+				spirv_instruction &load_inst = instructions.emplace_back(spv::OpLoad, &_memory);
+				load_inst.type = variable_type;
+				load_inst.result = make_id();
+				load_inst.add(variable);
+
+				spirv_instruction &element_inst = instructions.emplace_back(inst.op == spv::OpLoad ? spv::OpCompositeExtract : spv::OpCompositeInsert, &_memory);
+				if (inst.op == spv::OpLoad)
+				{
+					element_inst.type = inst.type;
+					element_inst.result = inst.result;
+				}
+				else
+				{
+					element_inst.type = variable_type;
+					element_inst.result = make_id();
+					element_inst.add(inst.operands[1]); // Object
+				}
+				element_inst.add(instructions[instructions.size() - 2].result); // Composite
+				element_inst.add(access_chain->begin() + 1, access_chain->end()); // Literal indices
+
+				if (inst.op == spv::OpStore)
+				{
+					const spv::Id value = element_inst.result;
+					instructions.emplace_back(spv::OpStore, &_memory)
+						.add(variable)
+						.add(value);
+				}
+			}
+
+			block.instructions = std::move(instructions);
+		}
+
+		// Build the control flow graph
+		std::unordered_map<spv::Id, size_t> block_lookup;
+		for (size_t block_index = 0; block_index < blocks.size(); ++block_index)
+			block_lookup.emplace(blocks[block_index].instructions[0].result, block_index);
+
+		std::vector<std::vector<size_t>> successors(blocks.size()), predecessors(blocks.size());
+		for (size_t block_index = 0; block_index < blocks.size(); ++block_index)
+		{
+			for_each_successor(blocks[block_index], [&](spv::Id target) {
+				const size_t target_index = block_lookup.at(target);
+				successors[block_index].push_back(target_index);
+				predecessors[target_index].push_back(block_index);
+			});
+		}
+
+		// Order reachable blocks in reverse post-order
+		std::vector<size_t> order, order_index(blocks.size(), std::numeric_limits<size_t>::max());
+		{
+			std::vector<bool> visited(blocks.size());
+			std::vector<std::pair<size_t, size_t>> stack = { { 0, 0 } };
+			visited[0] = true;
+
+			while (!stack.empty())
+			{
+				auto &[block_index, successor_index] = stack.back();
+				if (successor_index < successors[block_index].size())
+				{
+					const size_t next = successors[block_index][successor_index++];
+					if (!visited[next])
+					{
+						visited[next] = true;
+						stack.emplace_back(next, 0);
+					}
+					continue;
+				}
+
+				order.push_back(block_index);
+				stack.pop_back();
+			}
+
+			std::reverse(order.begin(), order.end());
+			for (size_t i = 0; i < order.size(); ++i)
+				order_index[order[i]] = i;
+		}
+
+		// Compute immediate dominators (see "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and Kennedy)
+		std::vector<size_t> dominators(blocks.size(), std::numeric_limits<size_t>::max());
+		dominators[0] = 0;
+
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+
+			for (size_t i = 1; i < order.size(); ++i)
+			{
+				size_t new_dominator = std::numeric_limits<size_t>::max();
+
+				for (size_t predecessor : predecessors[order[i]])
+				{
+					if (dominators[predecessor] == std::numeric_limits<size_t>::max())
+						continue;
+
+					if (new_dominator == std::numeric_limits<size_t>::max())
+					{
+						new_dominator = predecessor;
+						continue;
+					}
+
+					while (predecessor != new_dominator)
+					{
+						while (order_index[predecessor] > order_index[new_dominator])
+							predecessor = dominators[predecessor];
+						while (order_index[new_dominator] > order_index[predecessor])
+							new_dominator = dominators[new_dominator];
+					}
+				}
+
+				if (dominators[order[i]] != new_dominator)
+				{
+					dominators[order[i]] = new_dominator;
+					changed = true;
+				}
+			}
+		}
+
+		std::vector<std::vector<size_t>> dominance_frontiers(blocks.size()), dominator_tree(blocks.size());
+		for (size_t i = 1; i < order.size(); ++i)
+		{
+			const size_t block_index = order[i];
+			dominator_tree[dominators[block_index]].push_back(block_index);
+
+			if (predecessors[block_index].size() < 2)
+				continue;
+
+			for (size_t runner : predecessors[block_index])
+			{
+				if (order_index[runner] == std::numeric_limits<size_t>::max())
+					continue; // Skip unreachable predecessors
+
+				for (; runner != dominators[block_index]; runner = dominators[runner])
+					if (std::find(dominance_frontiers[runner].begin(), dominance_frontiers[runner].end(), block_index) == dominance_frontiers[runner].end())
+						dominance_frontiers[runner].push_back(block_index);
+			}
+		}
+
+		// Place phi instructions at the iterated dominance frontier of all blocks storing to a variable
+		std::vector<spv::Id> variables;
+		std::unordered_map<spv::Id, size_t> variable_lookup;
+		for (const spirv_instruction &inst : function.variables.instructions)
+		{
+			if (inst.op == spv::OpVariable && variable_types.find(inst.result) != variable_types.end())
+			{
+				variable_lookup.emplace(inst.result, variables.size());
+				variables.push_back(inst.result);
+			}
+		}
+
+		std::vector<std::vector<size_t>> store_blocks(variables.size());
+		for (size_t block_index = 0; block_index < blocks.size(); ++block_index)
+			for (const spirv_instruction &inst : blocks[block_index].instructions)
+				if (inst.op == spv::OpStore)
+					if (const auto it = variable_lookup.find(inst.operands[0]); it != variable_lookup.end() &&
+						(store_blocks[it->second].empty() || store_blocks[it->second].back() != block_index))
+						store_blocks[it->second].push_back(block_index);
+
+		// List of variable index and phi instruction for every block
+		std::vector<std::vector<std::pair<size_t, spirv_instruction>>> phis(blocks.size());
+
+		for (size_t variable_index = 0; variable_index < variables.size(); ++variable_index)
+		{
+			std::vector<bool> has_phi(blocks.size()), was_added(blocks.size());
+			std::vector<size_t> worklist = store_blocks[variable_index];
+			for (size_t block_index : worklist)
+				was_added[block_index] = true;
+
+			while (!worklist.empty())
+			{
+				const size_t block_index = worklist.back();
+				worklist.pop_back();
+
+				for (const size_t frontier_index : dominance_frontiers[block_index])
+				{
+					if (has_phi[frontier_index])
+						continue;
+					has_phi[frontier_index] = true;
+
+					spirv_instruction phi(spv::OpPhi, &_memory);
+					phi.type = variable_types.at(variables[variable_index]);
+					phi.result = make_id();
+					phis[frontier_index].emplace_back(variable_index, std::move(phi));
+
+					if (!was_added[frontier_index])
+					{
+						was_added[frontier_index] = true;
+						worklist.push_back(frontier_index);
+					}
+				}
+			}
+		}
+
+		// Replace loads with the current value of the variable, walking the dominator tree depth-first
+		std::unordered_map<spv::Id, spv::Id> replacements;
+		const auto resolve = [&replacements](spv::Id &id) {
+			for (auto it = replacements.find(id); it != replacements.end(); it = replacements.find(id))
+				id = it->second;
+		};
+
+		std::vector<std::vector<spv::Id>> current_values(variables.size());
+		const auto current_value = [&](size_t variable_index) {
+			return current_values[variable_index].empty() ? get_undef(info, variable_types.at(variables[variable_index])) : current_values[variable_index].back();
+		};
+
+		std::vector<std::vector<size_t>> pushed_values(blocks.size());
+		std::vector<std::pair<size_t, size_t>> stack = { { 0, 0 } };
+
+		while (!stack.empty())
+		{
+			auto &[block_index, child_index] = stack.back();
+
+			if (child_index == 0)
+			{
+				for (const auto &[variable_index, phi] : phis[block_index])
+				{
+					current_values[variable_index].push_back(phi.result);
+					pushed_values[block_index].push_back(variable_index);
+				}
+
+				std::vector<spirv_instruction> &instructions = blocks[block_index].instructions;
+				for (spirv_instruction &inst : instructions)
+				{
+					for_each_id_operand(inst, resolve);
+
+					if (inst.op == spv::OpLoad)
+					{
+						if (const auto it = variable_lookup.find(inst.operands[0]); it != variable_lookup.end())
+						{
+							replacements[inst.result] = current_value(it->second);
+							inst.op = spv::OpNop; // Removed below
+						}
+					}
+					else if (inst.op == spv::OpStore)
+					{
+						if (const auto it = variable_lookup.find(inst.operands[0]); it != variable_lookup.end())
+						{
+							current_values[it->second].push_back(inst.operands[1]);
+							pushed_values[block_index].push_back(it->second);
+							inst.op = spv::OpNop; // Removed below
+						}
+					}
+				}
+
+				// Remove all promoted loads and stores at once, rather than one at a time
+				instructions.erase(std::remove_if(instructions.begin(), instructions.end(),
+					[](const spirv_instruction &inst) { return inst.op == spv::OpNop; }), instructions.end());
+
+				for (const size_t successor_index : successors[block_index])
+					for (auto &[variable_index, phi] : phis[successor_index])
+						phi.add(current_value(variable_index))
+							.add(instructions[0].result);
+			}
+
+			if (child_index < dominator_tree[block_index].size())
+			{
+				const size_t next = dominator_tree[block_index][child_index++];
+				stack.emplace_back(next, 0);
+				continue;
+			}
+
+			for (const size_t variable_index : pushed_values[block_index])
+				current_values[variable_index].pop_back();
+			stack.pop_back();
+		}
+
+		// Insert phi instructions at the start of their block
+		for (size_t block_index = 0; block_index < blocks.size(); ++block_index)
+		{
+			if (phis[block_index].empty())
+				continue;
+
+			std::vector<spirv_instruction> &instructions = blocks[block_index].instructions;
+
+			for (auto &[variable_index, phi] : phis[block_index])
+			{
+				// Values coming from unreachable predecessors are undefined
+				for (const size_t predecessor : predecessors[block_index])
+					if (order_index[predecessor] == std::numeric_limits<size_t>::max())
+						phi.add(get_undef(info, phi.type))
+							.add(blocks[predecessor].instructions[0].result);
+			}
+
+			std::vector<spirv_instruction> phi_instructions;
+			for (auto &[variable_index, phi] : phis[block_index])
+				phi_instructions.push_back(std::move(phi));
+			instructions.insert(instructions.begin() + 1, std::make_move_iterator(phi_instructions.begin()), std::make_move_iterator(phi_instructions.end()));
+		}
+
+		for (spirv_basic_block &block : blocks)
+			for (spirv_instruction &inst : block.instructions)
+				for_each_id_operand(inst, resolve);
+
+		function.variables.instructions.erase(std::remove_if(function.variables.instructions.begin(), function.variables.instructions.end(),
+			[&variable_lookup](const spirv_instruction &inst) { return inst.op == spv::OpVariable && variable_lookup.find(inst.result) != variable_lookup.end(); }), function.variables.instructions.end());
+	}
+
+	/// <summary>
+	/// Evaluates instructions whose operands are all constants and simplifies instructions that do not need to be executed at runtime (e.g. extracting from a composite that was just constructed).
+	/// </summary>
+	/// <returns><see langword="true"/> if anything was changed, <see langword="false"/> otherwise.</returns>
+	bool fold_constants(optimization_info &info, std::vector<spirv_basic_block> &blocks)
+	{
+		std::unordered_map<spv::Id, const spirv_instruction *> definitions;
+		std::unordered_map<spv::Id, spv::Id> replacements;
+		const auto resolve = [&replacements](spv::Id &id) {
+			for (auto it = replacements.find(id); it != replacements.end(); it = replacements.find(id))
+				id = it->second;
+		};
+
+		bool changed = false, changed_control_flow = false;
+
+		for (spirv_basic_block &block : blocks)
+		{
+			for (size_t inst_index = 0; inst_index < block.instructions.size(); ++inst_index)
+			{
+				spirv_instruction &inst = block.instructions[inst_index];
+				for_each_id_operand(inst, resolve);
+
+				if (inst.result != 0)
+					definitions[inst.result] = &inst;
+
+				spv::Id replacement = 0;
+
+				switch (inst.op)
+				{
+				case spv::OpCopyObject:
+					replacement = inst.operands[0];
+					break;
+				case spv::OpPhi:
+					// Phi instructions that only ever select a single value are redundant
+					for (size_t i = 0; i < inst.operands.size(); i += 2)
+					{
+						if (inst.operands[i] == inst.result || inst.operands[i] == replacement)
+							continue;
+						if (replacement != 0)
+						{
+							replacement = 0;
+							break;
+						}
+						replacement = inst.operands[i];
+					}
+					break;
+				case spv::OpSelect:
+					if (const auto it = info.scalar_constants.find(inst.operands[0]); it != info.scalar_constants.end())
+						replacement = inst.operands[it->second.second ? 1 : 2];
+					else
+						replacement = evaluate_constant_operation(info, inst);
+					break;
+				case spv::OpCompositeExtract:
+					changed |= fold_composite_extract(info, definitions, inst);
+					if (inst.operands.size() == 1)
+						replacement = inst.operands[0];
+					break;
+				case spv::OpBranchConditional:
+					if (const auto it = info.scalar_constants.find(inst.operands[0]); it != info.scalar_constants.end())
+					{
+						const spv::Id target = inst.operands[it->second.second ? 1 : 2];
+						inst.op = spv::OpBranch;
+						inst.operands.clear();
+						inst.add(target);
+
+						// There is only a single path left, so the selection construct is no longer needed either
+						for (size_t i = inst_index; i-- > 0 && block.instructions[i].op != spv::OpLabel;)
+							if (block.instructions[i].op == spv::OpSelectionMerge)
+								block.instructions[i].op = spv::OpNop;
+
+						changed_control_flow = true;
+					}
+					break;
+				default:
+					replacement = evaluate_constant_operation(info, inst);
+					break;
+				}
+
+				if (replacement != 0 && replacement != inst.result)
+					replacements[inst.result] = replacement;
+			}
+		}
+
+		if (replacements.empty() && !changed && !changed_control_flow)
+			return false;
+
+		for (spirv_basic_block &block : blocks)
+		{
+			block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(),
+				[&replacements](const spirv_instruction &inst) { return inst.op == spv::OpNop || (inst.result != 0 && replacements.find(inst.result) != replacements.end()); }), block.instructions.end());
+
+			for (spirv_instruction &inst : block.instructions)
+				for_each_id_operand(inst, resolve);
+		}
+
+		if (changed_control_flow)
+			update_phi_operands(info, blocks);
+
+		return true;
+	}
+	/// <summary>
+	/// Simplifies a composite extract instruction by looking through the instructions that created the composite.
+	/// </summary>
+	/// <returns><see langword="true"/> if the instruction was changed, <see langword="false"/> otherwise. If it was reduced to a single operand, that operand is the extracted value.</returns>
+	static bool fold_composite_extract(const optimization_info &info, const std::unordered_map<spv::Id, const spirv_instruction *> &definitions, spirv_instruction &inst)
+	{
+		spv::Id composite = inst.operands[0];
+		std::vector<uint32_t> indices(inst.operands.begin() + 1, inst.operands.end());
+
+		while (!indices.empty())
+		{
+			if (const auto it = info.composite_constants.find(composite); it != info.composite_constants.end())
+			{
+				composite = it->second.second[indices[0]];
+				indices.erase(indices.begin());
+				continue;
+			}
+
+			const auto it = definitions.find(composite);
+			if (it == definitions.end())
+				break;
+			const spirv_instruction &definition = *it->second;
+
+			if (definition.op == spv::OpCompositeInsert)
+			{
+				const size_t num_insert_indices = definition.operands.size() - 2;
 
-		friend bool operator==(const function_blocks &lhs, const function_blocks &rhs)
-		{
-			if (lhs.param_types.size() != rhs.param_types.size())
-				return false;
-			for (size_t i = 0; i < lhs.param_types.size(); ++i)
-				if (!(lhs.param_types[i] == rhs.param_types[i]))
-					return false;
-			return lhs.return_type == rhs.return_type;
-		}
-	};
+				size_t i = 0;
+				while (i < num_insert_indices && i < indices.size() && definition.operands[2 + i] == indices[i])
+					++i;
 
-	spirv_basic_block _entries;
-	spirv_basic_block _execution_modes;
-	spirv_basic_block _debug_a;
-	spirv_basic_block _debug_b;
-	spirv_basic_block _annotations;
-	spirv_basic_block _types_and_constants;
-	spirv_basic_block _variables;
+				if (i == num_insert_indices)
+				{
+					// Extracting (part of) the inserted object
+					composite = definition.operands[0];
+					indices.erase(indices.begin(), indices.begin() + i);
+				}
+				else if (i < indices.size())
+				{
+					// Extracting an element that was not touched by the insert
+					composite = definition.operands[1];
+				}
+				else
+				{
+					break; // Extracting an element that contains the inserted object
+				}
+				continue;
+			}
+			if (definition.op == spv::OpCompositeConstruct)
+			{
+				// Vectors may be constructed from other vectors, in which case the operands do not map directly to the components
+				if (const auto type_it = info.vector_types.find(definition.type); type_it != info.vector_types.end() && type_it->second.second != definition.operands.size())
+					break;
 
-	std::unordered_set<spv::Id> _spec_constants;
-	std::unordered_set<spv::Capability> _capabilities;
-	std::vector<std::pair<type_lookup, spv::Id>> _type_lookup;
-	std::vector<std::tuple<type, constant, spv::Id>> _constant_lookup;
-	std::vector<std::pair<function_blocks, spv::Id>> _function_type_lookup;
-	std::unordered_map<std::string, spv::Id> _string_lookup;
-	std::unordered_map<spv::Id, spv::StorageClass> _storage_lookup;
-	std::unordered_map<std::string, uint32_t> _semantic_to_location;
+				composite = definition.operands[indices[0]];
+				indices.erase(indices.begin());
+				continue;
+			}
+			if (definition.op == spv::OpVectorShuffle)
+			{
+				const uint32_t component = definition.operands[2 + indices[0]];
+				if (component == 0xFFFFFFFF)
+					break;
 
-	std::vector<function_blocks> _functions_blocks;
-	std::unordered_map<id, spirv_basic_block> _block_data;
-	spirv_basic_block *_current_block_data = nullptr;
+				// Need to know the size of the first vector to determine which vector the component is taken from
+				uint32_t num_components = 0;
+				if (const auto vector_it = definitions.find(definition.operands[0]); vector_it != definitions.end())
+					num_components = info.vector_types.at(vector_it->second->type).second;
+				else if (const auto constant_it = info.composite_constants.find(definition.operands[0]); constant_it != info.composite_constants.end())
+					num_components = info.vector_types.at(constant_it->second.first).second;
+				else
+					break;
 
-	bool _debug_info = false;
-	bool _vulkan_semantics = false;
-	bool _uniforms_to_spec_constants = false;
-	bool _enable_16bit_types = false;
-	bool _flip_vert_y = false;
-	id _glsl_ext = 0;
-	id _global_ubo_type = 0;
-	id _global_ubo_variable = 0;
-	std::vector<spv::Id> _global_ubo_types;
-	function_blocks *_current_function = nullptr;
+				composite = definition.operands[component < num_components ? 0 : 1];
+				indices[0] = component < num_components ? component : component - num_components;
+				continue;
+			}
 
-	inline void add_location(const location &loc, spirv_basic_block &block)
+			break;
+		}
+
+		if (composite == inst.operands[0] && indices.size() + 1 == inst.operands.size())
+			return false;
+
+		inst.operands.clear();
+		inst.add(composite);
+		inst.add(indices.begin(), indices.end());
+		return true;
+	}
+	/// <summary>
+	/// Evaluates an arithmetic, logical or conversion instruction on scalar or vector constants at compile time.
+	/// </summary>
+	/// <returns>The ID of the constant holding the result, or zero if the instruction cannot be evaluated.</returns>
+	spv::Id evaluate_constant_operation(optimization_info &info, const spirv_instruction &inst)
 	{
-		if (loc.source.empty() || !_debug_info)
-			return;
+		if (inst.type == 0 || inst.operands.empty() || inst.operands.size() > 3)
+			return 0;
 
-		spv::Id file;
-		if (const auto it = _string_lookup.find(loc.source);
-			it != _string_lookup.end())
+		const auto result_type_it = info.vector_types.find(inst.type);
+		if (result_type_it == info.vector_types.end())
+			return 0;
+		const auto [result_component_type, num_components] = result_type_it->second;
+
+		// Gather the component values of all operands
+		uint32_t values[3][4] = {};
+		optimization_info::scalar_type operand_types[3] = {};
+
+		for (size_t i = 0; i < inst.operands.size(); ++i)
 		{
-			file = it->second;
+			spv::Id operand_type = 0;
+			if (const auto it = info.scalar_constants.find(inst.operands[i]); it != info.scalar_constants.end())
+			{
+				operand_type = it->second.first;
+				values[i][0] = it->second.second;
+				if (num_components != 1)
+					return 0;
+			}
+			else if (const auto composite_it = info.composite_constants.find(inst.operands[i]); composite_it != info.composite_constants.end())
+			{
+				if (composite_it->second.second.size() != num_components)
+					return 0;
+
+				for (uint32_t c = 0; c < num_components; ++c)
+				{
+					const auto component_it = info.scalar_constants.find(composite_it->second.second[c]);
+					if (component_it == info.scalar_constants.end())
+						return 0;
+
+					operand_type = component_it->second.first;
+					values[i][c] = component_it->second.second;
+				}
+			}
+			else
+			{
+				return 0;
+			}
+
+			operand_types[i] = info.scalar_types.at(operand_type);
+
+			// Only 32-bit types are supported
+			if (operand_types[i].width != 32)
+				return 0;
 		}
-		else
+
+		if (info.scalar_types.at(result_component_type).width != 32)
+			return 0;
+
+		const auto as_float = [](uint32_t value) { float result; std::memcpy(&result, &value, sizeof(result)); return result; };
+		const auto from_float = [](float value) { uint32_t result; std::memcpy(&result, &value, sizeof(result)); return result; };
+
+		uint32_t result[4] = {};
+
+		for (uint32_t c = 0; c < num_components; ++c)
 		{
-			add_instruction(spv::OpString, 0, _debug_a, file)
-				.add_string(loc.source.c_str());
-			_string_lookup.emplace(loc.source, file);
+			const uint32_t a = values[0][c], b = values[1][c];
+
+			switch (inst.op)
+			{
+			case spv::OpFNegate:
+				result[c] = from_float(-as_float(a));
+				break;
+			case spv::OpSNegate:
+				result[c] = 0u - a;
+				break;
+			case spv::OpNot:
+				result[c] = ~a;
+				break;
+			case spv::OpLogicalNot:
+				result[c] = !a;
+				break;
+			case spv::OpBitcast:
+				result[c] = a;
+				break;
+			case spv::OpConvertSToF:
+				result[c] = from_float(static_cast<float>(static_cast<int32_t>(a)));
+				break;
+			case spv::OpConvertUToF:
+				result[c] = from_float(static_cast<float>(a));
+				break;
+			case spv::OpConvertFToS:
+				// Conversion of values that are out of range is undefined, so leave those to the driver
+				if (!(as_float(a) > -2147483904.0f && as_float(a) < 2147483648.0f))
+					return 0;
+				result[c] = static_cast<uint32_t>(static_cast<int32_t>(as_float(a)));
+				break;
+			case spv::OpConvertFToU:
+				if (!(as_float(a) > -1.0f && as_float(a) < 4294967296.0f))
+					return 0;
+				result[c] = static_cast<uint32_t>(as_float(a));
+				break;
+			case spv::OpFAdd:
+				result[c] = from_float(as_float(a) + as_float(b));
+				break;
+			case spv::OpFSub:
+				result[c] = from_float(as_float(a) - as_float(b));
+				break;
+			case spv::OpFMul:
+				result[c] = from_float(as_float(a) * as_float(b));
+				break;
+			case spv::OpFDiv:
+				if (as_float(b) == 0.0f)
+					return 0;
+				result[c] = from_float(as_float(a) / as_float(b));
+				break;
+			case spv::OpIAdd:
+				result[c] = a + b;
+				break;
+			case spv::OpISub:
+				result[c] = a - b;
+				break;
+			case spv::OpIMul:
+				result[c] = a * b;
+				break;
+			case spv::OpUDiv:
+				if (b == 0)
+					return 0;
+				result[c] = a / b;
+				break;
+			case spv::OpUMod:
+				if (b == 0)
+					return 0;
+				result[c] = a % b;
+				break;
+			case spv::OpFOrdEqual:
+				result[c] = as_float(a) == as_float(b);
+				break;
+			case spv::OpFOrdNotEqual:
+				result[c] = as_float(a) < as_float(b) || as_float(a) > as_float(b);
+				break;
+			case spv::OpFOrdLessThan:
+				result[c] = as_float(a) < as_float(b);
+				break;
+			case spv::OpFOrdLessThanEqual:
+				result[c] = as_float(a) <= as_float(b);
+				break;
+			case spv::OpFOrdGreaterThan:
+				result[c] = as_float(a) > as_float(b);
+				break;
+			case spv::OpFOrdGreaterThanEqual:
+				result[c] = as_float(a) >= as_float(b);
+				break;
+			case spv::OpIEqual:
+			case spv::OpLogicalEqual:
+				result[c] = a == b;
+				break;
+			case spv::OpINotEqual:
+			case spv::OpLogicalNotEqual:
+				result[c] = a != b;
+				break;
+			case spv::OpSLessThan:
+				result[c] = static_cast<int32_t>(a) < static_cast<int32_t>(b);
+				break;
+			case spv::OpSLessThanEqual:
+				result[c] = static_cast<int32_t>(a) <= static_cast<int32_t>(b);
+				break;
+			case spv::OpSGreaterThan:
+				result[c] = static_cast<int32_t>(a) > static_cast<int32_t>(b);
+				break;
+			case spv::OpSGreaterThanEqual:
+				result[c] = static_cast<int32_t>(a) >= static_cast<int32_t>(b);
+				break;
+			case spv::OpULessThan:
+				result[c] = a < b;
+				break;
+			case spv::OpULessThanEqual:
+				result[c] = a <= b;
+				break;
+			case spv::OpUGreaterThan:
+				result[c] = a > b;
+				break;
+			case spv::OpUGreaterThanEqual:
+				result[c] = a >= b;
+				break;
+			case spv::OpLogicalAnd:
+				result[c] = a && b;
+				break;
+			case spv::OpLogicalOr:
+				result[c] = a || b;
+				break;
+			case spv::OpBitwiseAnd:
+				result[c] = a & b;
+				break;
+			case spv::OpBitwiseOr:
+				result[c] = a | b;
+				break;
+			case spv::OpBitwiseXor:
+				result[c] = a ^ b;
+				break;
+			case spv::OpShiftLeftLogical:
+				if (b >= 32)
+					return 0;
+				result[c] = a << b;
+				break;
+			case spv::OpShiftRightLogical:
+				if (b >= 32)
+					return 0;
+				result[c] = a >> b;
+				break;
+			case spv::OpShiftRightArithmetic:
+				if (b >= 32)
+					return 0;
+				result[c] = static_cast<uint32_t>(static_cast<int32_t>(a) >> b);
+				break;
+			case spv::OpSelect:
+				result[c] = a ? b : values[2][c];
+				break;
+			default:
+				return 0;
+			}
 		}
 
-		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpLine
-		add_instruction_without_result(spv::OpLine, block)
-			.add(file)
-			.add(loc.line)
-			.add(loc.column);
-	}
-	inline spirv_instruction &add_instruction(spv::Op op, spv::Id type = 0)
-	{
-		assert(is_in_function() && is_in_block());
-		return add_instruction(op, type, *_current_block_data);
-	}
-	inline spirv_instruction &add_instruction(spv::Op op, spv::Id type, spirv_basic_block &block)
-	{
-		spirv_instruction &instruction = add_instruction_without_result(op, block);
-		instruction.type = type;
-		instruction.result = make_id();
-		return instruction;
-	}
-	inline spirv_instruction &add_instruction(spv::Op op, spv::Id type, spirv_basic_block &block, spv::Id &result)
-	{
-		spirv_instruction &instruction = add_instruction_without_result(op, block);
-		instruction.type = type;
-		instruction.result = result = make_id();
-		return instruction;
-	}
-	inline spirv_instruction &add_instruction_without_result(spv::Op op)
-	{
-		assert(is_in_function() && is_in_block());
-		return add_instruction_without_result(op, *_current_block_data);
-	}
-	inline spirv_instruction &add_instruction_without_result(spv::Op op, spirv_basic_block &block)
-	{
-		return block.instructions.emplace_back(op);
+		if (num_components == 1 && result_component_type == inst.type)
+			return get_scalar_constant(info, inst.type, result[0]);
+
+		std::vector<spv::Id> components;
+		for (uint32_t c = 0; c < num_components; ++c)
+			components.push_back(get_scalar_constant(info, result_component_type, result[c]));
+		return get_composite_constant(info, inst.type, std::move(components));
 	}
 
-	void write_result(module &module) override
+	/// <summary>
+	/// Removes all instructions whose result is never used and that do not have side effects, as well as stores to local variables that are never read.
+	/// </summary>
+	void eliminate_dead_code(function_blocks &function, std::vector<spirv_basic_block> &blocks)
 	{
-		// First initialize the UBO type now that all member types are known
-		if (_global_ubo_type != 0)
+		std::unordered_set<spv::Id> local_variables, read_variables;
+		for (const spirv_instruction &inst : function.variables.instructions)
+			if (inst.op == spv::OpVariable)
+				local_variables.insert(inst.result);
+
+		for (spirv_basic_block &block : blocks)
 		{
-			spirv_instruction &type_inst = add_instruction_without_result(spv::OpTypeStruct, _types_and_constants);
-			type_inst.add(_global_ubo_types.begin(), _global_ubo_types.end());
-			type_inst.result = _global_ubo_type;
+			for (spirv_instruction &inst : block.instructions)
+			{
+				for_each_id_operand(inst, [&](spv::Id &id) {
+					if (inst.op == spv::OpStore && &id == &inst.operands[0])
+						return;
+					if (local_variables.find(id) != local_variables.end())
+						read_variables.insert(id);
+				});
+			}
+		}
 
-			spirv_instruction &variable_inst = add_instruction_without_result(spv::OpVariable, _variables);
-			variable_inst.add(spv::StorageClassUniform);
-			variable_inst.type = convert_type({ type::t_struct, 0, 0, type::q_uniform, 0, _global_ubo_type }, true, spv::StorageClassUniform);
-			variable_inst.result = _global_ubo_variable;
+		std::unordered_map<spv::Id, spirv_instruction *> definitions;
+		std::unordered_set<spv::Id> live;
+		std::vector<spirv_instruction *> worklist;
 
-			add_name(variable_inst.result, "$Globals");
-		}
+		for (spirv_basic_block &block : blocks)
+		{
+			for (spirv_instruction &inst : block.instructions)
+			{
+				if (inst.op == spv::OpStore && local_variables.find(inst.operands[0]) != local_variables.end() && read_variables.find(inst.operands[0]) == read_variables.end())
+				{
+					inst.op = spv::OpNop; // Never read, so no need to store anything
+					continue;
+				}
 
-		module = std::move(_module);
+				if (inst.result != 0)
+					definitions.emplace(inst.result, &inst);
 
-		// Write SPIRV header info
-		module.spirv.push_back(spv::MagicNumber);
-		module.spirv.push_back(0x10300); // Force SPIR-V 1.3
-		module.spirv.push_back(0u); // Generator magic number, see https://www.khronos.org/registry/spir-v/api/spir-v.xml
-		module.spirv.push_back(_next_id); // Maximum ID
-		module.spirv.push_back(0u); // Reserved for instruction schema
+				// Instructions without a result (stores, branches, ...) and those with side effects always have to stay
+				switch (inst.op)
+				{
+				case spv::OpLabel:
+				case spv::OpFunctionCall:
+				case spv::OpAtomicAnd:
+				case spv::OpAtomicCompareExchange:
+				case spv::OpAtomicExchange:
+				case spv::OpAtomicIAdd:
+				case spv::OpAtomicOr:
+				case spv::OpAtomicSMax:
+				case spv::OpAtomicSMin:
+				case spv::OpAtomicUMax:
+				case spv::OpAtomicUMin:
+				case spv::OpAtomicXor:
+					live.insert(inst.result);
+					worklist.push_back(&inst);
+					break;
+				default:
+					if (inst.result == 0)
+						worklist.push_back(&inst);
+					break;
+				}
+			}
+		}
 
-		// All capabilities
-		spirv_instruction(spv::OpCapability)
-			.add(spv::CapabilityShader) // Implicitly declares the Matrix capability too
-			.write(module.spirv);
+		for (spirv_instruction &inst : function.variables.instructions)
+			if (inst.result != 0)
+				definitions.emplace(inst.result, &inst);
 
-		for (spv::Capability capability : _capabilities)
-			spirv_instruction(spv::OpCapability)
-				.add(capability)
-				.write(module.spirv);
+		while (!worklist.empty())
+		{
+			spirv_instruction &inst = *worklist.back();
+			worklist.pop_back();
 
-		// Optional extension instructions
-		spirv_instruction(spv::OpExtInstImport, _glsl_ext)
-			.add_string("GLSL.std.450") // Import GLSL extension
-			.write(module.spirv);
+			for_each_id_operand(inst, [&](spv::Id &id) {
+				if (const auto it = definitions.find(id); it != definitions.end() && live.insert(id).second)
+					worklist.push_back(it->second);
+			});
+		}
 
-		// Single required memory model instruction
-		spirv_instruction(spv::OpMemoryModel)
-			.add(spv::AddressingModelLogical)
-			.add(spv::MemoryModelGLSL450)
-			.write(module.spirv);
+		const auto is_dead = [&live](const spirv_instruction &inst) {
+			return inst.op == spv::OpNop || (inst.result != 0 && live.find(inst.result) == live.end());
+		};
 
-		// All entry point declarations
-		for (const auto &node : _entries.instructions)
-			node.write(module.spirv);
+		for (spirv_basic_block &block : blocks)
+			block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(), is_dead), block.instructions.end());
+		function.variables.instructions.erase(std::remove_if(function.variables.instructions.begin(), function.variables.instructions.end(), is_dead), function.variables.instructions.end());
+	}
 
-		// All execution mode declarations
-		for (const auto &node : _execution_modes.instructions)
-			node.write(module.spirv);
+	/// <summary>
+	/// Removes functions that are no longer called after inlining, private global variables that are never referenced and any names and decorations of removed IDs.
+	/// </summary>
+	void remove_unused_functions_and_variables(const optimization_info &info)
+	{
+		std::unordered_set<spv::Id> referenced;
 
-		spirv_instruction(spv::OpSource)
-			.add(spv::SourceLanguageUnknown) // ReShade FX is not a reserved token at the moment
-			.add(0) // Language version, TODO: Maybe fill in ReShade version here?
-			.write(module.spirv);
+		for (const spirv_instruction &inst : _entries.instructions)
+			referenced.insert(inst.operands[1]);
 
-		if (_debug_info)
+		// Only need to look at functions that are referenced themselves, which requires walking the call graph
+		std::vector<spv::Id> worklist(referenced.begin(), referenced.end());
+		while (!worklist.empty())
 		{
-			// All debug instructions
-			for (const auto &node : _debug_a.instructions)
-				node.write(module.spirv);
-			for (const auto &node : _debug_b.instructions)
-				node.write(module.spirv);
-		}
+			const auto function_it = info.function_lookup.find(worklist.back());
+			worklist.pop_back();
+			if (function_it == info.function_lookup.end())
+				continue;
 
-		// All annotation instructions
-		for (const auto &node : _annotations.instructions)
-			node.write(module.spirv);
+			function_blocks &function = _functions_blocks[function_it->second];
+			for (spirv_basic_block *block : { &function.variables, &function.definition })
+				for (spirv_instruction &inst : block->instructions)
+					for_each_id_operand(inst, [&](spv::Id &id) {
+						if (referenced.insert(id).second && info.function_lookup.find(id) != info.function_lookup.end())
+							worklist.push_back(id);
+					});
+		}
 
-		// All type declarations
-		for (const auto &node : _types_and_constants.instructions)
-			node.write(module.spirv);
-		for (const auto &node : _variables.instructions)
-			node.write(module.spirv);
+		std::unordered_set<spv::Id> defined = { _glsl_ext };
 
-		// All function definitions
-		for (const auto &function : _functions_blocks)
+		for (function_blocks &function : _functions_blocks)
 		{
-			if (function.definition.instructions.empty())
+			const auto function_inst = std::find_if(function.declaration.instructions.begin(), function.declaration.instructions.end(),
+				[](const spirv_instruction &inst) { return inst.op == spv::OpFunction; });
+			if (function.definition.instructions.empty() || function_inst == function.declaration.instructions.end())
 				continue;
 
-			for (const auto &node : function.declaration.instructions)
-				node.write(module.spirv);
-
-			// Grab first label and move it in front of variable declarations
-			function.definition.instructions.front().write(module.spirv);
-			assert(function.definition.instructions.front().op == spv::OpLabel);
+			if (referenced.find(function_inst->result) == referenced.end())
+			{
+				function.declaration.instructions.clear();
+				function.variables.instructions.clear();
+				function.definition.instructions.clear();
+				continue;
+			}
 
-			for (const auto &node : function.variables.instructions)
-				node.write(module.spirv);
-			for (auto it = function.definition.instructions.begin() + 1; it != function.definition.instructions.end(); ++it)
-				it->write(module.spirv);
+			for (const spirv_basic_block *block : { &function.declaration, &function.variables, &function.definition })
+				for (const spirv_instruction &inst : block->instructions)
+					defined.insert(inst.result);
 		}
+
+		_variables.instructions.erase(std::remove_if(_variables.instructions.begin(), _variables.instructions.end(),
+			[&referenced](const spirv_instruction &inst) { return inst.op == spv::OpVariable && inst.operands[0] == spv::StorageClassPrivate && referenced.find(inst.result) == referenced.end(); }), _variables.instructions.end());
+
+		for (const spirv_basic_block *block : { &_debug_a, &_types_and_constants, &_variables })
+			for (const spirv_instruction &inst : block->instructions)
+				defined.insert(inst.result);
+
+		const auto is_undefined_target = [&defined](const spirv_instruction &inst) {
+			return (inst.op == spv::OpName || inst.op == spv::OpDecorate) && defined.find(inst.operands[0]) == defined.end();
+		};
+
+		_debug_b.instructions.erase(std::remove_if(_debug_b.instructions.begin(), _debug_b.instructions.end(), is_undefined_target), _debug_b.instructions.end());
+		_annotations.instructions.erase(std::remove_if(_annotations.instructions.begin(), _annotations.instructions.end(), is_undefined_target), _annotations.instructions.end());
 	}
 
 	spv::Id convert_type(type info, bool is_ptr = false, spv::StorageClass storage = spv::StorageClassFunction, uint32_t array_stride = 0)
@@ -354,8 +2101,7 @@ private:
 			info.base = static_cast<type::datatype>(info.base + 1); // min16int -> int, min16uint -> uint, min16float -> float
 
 		const type_lookup lookup = { info, is_ptr, array_stride, storage };
-		if (const auto it = std::find_if(_type_lookup.begin(), _type_lookup.end(),
-			[&lookup](const auto &lookup_it) { return lookup_it.first == lookup; }); it != _type_lookup.end())
+		if (const auto it = _type_lookup.find(lookup); it != _type_lookup.end())
 			return it->second;
 
 		spv::Id type, elem_type;
@@ -499,14 +2245,14 @@ private:
 			}
 		}
 
-		_type_lookup.push_back({ lookup, type });
+		_type_lookup.emplace(lookup, type);
 
 		return type;
 	}
 	spv::Id convert_type(const function_blocks &info)
 	{
-		if (auto it = std::find_if(_function_type_lookup.begin(), _function_type_lookup.end(),
-			[&info](const auto &lookup) { return lookup.first == info; }); it != _function_type_lookup.end())
+		function_type_lookup lookup = { info.return_type, info.param_types };
+		if (const auto it = _function_type_lookup.find(lookup); it != _function_type_lookup.end())
 			return it->second;
 
 		auto return_type = convert_type(info.return_type);
@@ -521,7 +2267,7 @@ private:
 		inst.add(return_type);
 		inst.add(param_type_ids.begin(), param_type_ids.end());
 
-		_function_type_lookup.push_back({ info, inst.result });;
+		_function_type_lookup.emplace(std::move(lookup), inst.result);
 
 		return inst.result;
 	}
@@ -945,7 +2691,7 @@ private:
 			[&func](const auto &ep) { return ep.name == func.unique_name; }); it != _module.entry_points.end())
 			return;
 
-		_module.entry_points.push_back({ func.unique_name, stype });
+		_module.entry_points.push_back({ func.unique_name, stype, {}, {} });
 
 		spv::Id position_variable = 0, point_size_variable = 0;
 		std::vector<spv::Id> inputs_and_outputs;
@@ -1655,15 +3401,8 @@ private:
 	id   emit_constant(const type &type, const constant &data, bool spec_constant)
 	{
 		if (!spec_constant) // Specialization constants cannot reuse other constants
-			if (auto it = std::find_if(_constant_lookup.begin(), _constant_lookup.end(), [&type, &data](auto &x) {
-				if (!(std::get<0>(x) == type && std::memcmp(&std::get<1>(x).as_uint[0], &data.as_uint[0], sizeof(uint32_t) * 16) == 0 && std::get<1>(x).array_data.size() == data.array_data.size()))
-					return false;
-				for (size_t i = 0; i < data.array_data.size(); ++i)
-					if (std::memcmp(&std::get<1>(x).array_data[i].as_uint[0], &data.array_data[i].as_uint[0], sizeof(uint32_t) * 16) != 0)
-						return false;
-				return true;
-			}); it != _constant_lookup.end())
-				return std::get<2>(*it); // Re-use existing constant instead of duplicating the definition
+			if (const auto it = _constant_lookup.find({ type, data }); it != _constant_lookup.end())
+				return it->second; // Re-use existing constant instead of duplicating the definition
 
 		spv::Id result;
 		if (type.is_array())
@@ -1745,7 +3484,7 @@ private:
 		if (spec_constant) // Keep track of all specialization constants
 			_spec_constants.insert(result);
 		else
-			_constant_lookup.push_back({ type, data, result });
+			_constant_lookup.emplace(constant_lookup { type, data }, result);
 
 		return result;
 	}
@@ -2243,7 +3982,7 @@ private:
 	}
 };
 
-codegen *reshadefx::create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y)
+codegen *reshadefx::create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y, bool optimize)
 {
-	return new codegen_spirv(vulkan_semantics, debug_info, uniforms_to_spec_constants, enable_16bit_types, flip_vert_y);
+	return new codegen_spirv(vulkan_semantics, debug_info, uniforms_to_spec_constants, enable_16bit_types, flip_vert_y, optimize);
 }
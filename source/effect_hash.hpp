@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring> // std::memcpy
+#include <algorithm> // std::min
+
+namespace reshadefx
+{
+	/// <summary>
+	/// A 128-bit hash value.
+	/// </summary>
+	struct hash128
+	{
+		uint64_t low = 0;
+		uint64_t high = 0;
+
+		/// <summary>
+		/// Returns the hash value formatted as a 32 character hexadecimal string (suitable for use in file names).
+		/// </summary>
+		std::string to_string() const
+		{
+			std::string result(32, '0');
+			for (size_t i = 0; i < 16; ++i)
+			{
+				result[i] = "0123456789abcdef"[(high >> ((15 - i) * 4)) & 0xF];
+				result[i + 16] = "0123456789abcdef"[(low >> ((15 - i) * 4)) & 0xF];
+			}
+			return result;
+		}
+
+		friend inline bool operator==(const hash128 &lhs, const hash128 &rhs) { return lhs.low == rhs.low && lhs.high == rhs.high; }
+		friend inline bool operator!=(const hash128 &lhs, const hash128 &rhs) { return !operator==(lhs, rhs); }
+	};
+
+	/// <summary>
+	/// Streaming 128-bit non-cryptographic hash function (MurmurHash3, x64 128-bit variant).
+	/// The result only depends on the input bytes (not on the compiler, platform or build), so it is safe to use it for keys of data persisted on disk.
+	/// </summary>
+	class hasher
+	{
+	public:
+		explicit hasher(uint64_t seed = 0) : _h1(seed), _h2(seed) {}
+
+		/// <summary>
+		/// Feeds the specified bytes into the hash function.
+		/// </summary>
+		void update(const void *data, size_t size)
+		{
+			const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+			_total_size += size;
+
+			// Complete a previously started block first
+			if (_buffer_size != 0)
+			{
+				const size_t count = std::min(size, sizeof(_buffer) - _buffer_size);
+				std::memcpy(_buffer + _buffer_size, bytes, count);
+				_buffer_size += count;
+				bytes += count;
+				size -= count;
+
+				if (_buffer_size < sizeof(_buffer))
+					return;
+
+				process_block(_buffer);
+				_buffer_size = 0;
+			}
+
+			for (; size >= sizeof(_buffer); bytes += sizeof(_buffer), size -= sizeof(_buffer))
+				process_block(bytes);
+
+			std::memcpy(_buffer, bytes, size);
+			_buffer_size = size;
+		}
+		void update(const std::string_view data)
+		{
+			update(data.data(), data.size());
+		}
+		void update(uint64_t value)
+		{
+			uint8_t bytes[8];
+			for (size_t i = 0; i < 8; ++i)
+				bytes[i] = static_cast<uint8_t>(value >> (i * 8)); // Always hash in little-endian byte order
+			update(bytes, sizeof(bytes));
+		}
+
+		/// <summary>
+		/// Returns the hash of all data fed into the hash function so far.
+		/// </summary>
+		hash128 finalize() const
+		{
+			uint64_t h1 = _h1, h2 = _h2;
+			uint64_t k1 = 0, k2 = 0;
+
+			switch (_buffer_size)
+			{
+			case 15: k2 ^= static_cast<uint64_t>(_buffer[14]) << 48; [[fallthrough]];
+			case 14: k2 ^= static_cast<uint64_t>(_buffer[13]) << 40; [[fallthrough]];
+			case 13: k2 ^= static_cast<uint64_t>(_buffer[12]) << 32; [[fallthrough]];
+			case 12: k2 ^= static_cast<uint64_t>(_buffer[11]) << 24; [[fallthrough]];
+			case 11: k2 ^= static_cast<uint64_t>(_buffer[10]) << 16; [[fallthrough]];
+			case 10: k2 ^= static_cast<uint64_t>(_buffer[ 9]) <<  8; [[fallthrough]];
+			case  9: k2 ^= static_cast<uint64_t>(_buffer[ 8]);
+				k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+				[[fallthrough]];
+			case  8: k1 ^= static_cast<uint64_t>(_buffer[ 7]) << 56; [[fallthrough]];
+			case  7: k1 ^= static_cast<uint64_t>(_buffer[ 6]) << 48; [[fallthrough]];
+			case  6: k1 ^= static_cast<uint64_t>(_buffer[ 5]) << 40; [[fallthrough]];
+			case  5: k1 ^= static_cast<uint64_t>(_buffer[ 4]) << 32; [[fallthrough]];
+			case  4: k1 ^= static_cast<uint64_t>(_buffer[ 3]) << 24; [[fallthrough]];
+			case  3: k1 ^= static_cast<uint64_t>(_buffer[ 2]) << 16; [[fallthrough]];
+			case  2: k1 ^= static_cast<uint64_t>(_buffer[ 1]) <<  8; [[fallthrough]];
+			case  1: k1 ^= static_cast<uint64_t>(_buffer[ 0]);
+				k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+			}
+
+			h1 ^= _total_size;
+			h2 ^= _total_size;
+			h1 += h2;
+			h2 += h1;
+			h1 = fmix(h1);
+			h2 = fmix(h2);
+			h1 += h2;
+			h2 += h1;
+
+			return { h1, h2 };
+		}
+
+	private:
+		static constexpr uint64_t c1 = 0x87c37b91114253d5ull;
+		static constexpr uint64_t c2 = 0x4cf5ad432745937full;
+
+		static inline uint64_t rotl(uint64_t x, int r)
+		{
+			return (x << r) | (x >> (64 - r));
+		}
+		static inline uint64_t fmix(uint64_t k)
+		{
+			k ^= k >> 33;
+			k *= 0xff51afd7ed558ccdull;
+			k ^= k >> 33;
+			k *= 0xc4ceb9fe1a85ec53ull;
+			k ^= k >> 33;
+			return k;
+		}
+		static inline uint64_t load_64(const uint8_t *bytes)
+		{
+			uint64_t value = 0;
+			for (size_t i = 0; i < 8; ++i)
+				value |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+			return value;
+		}
+
+		void process_block(const uint8_t *block)
+		{
+			uint64_t k1 = load_64(block);
+			uint64_t k2 = load_64(block + 8);
+
+			k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; _h1 ^= k1;
+			_h1 = rotl(_h1, 27); _h1 += _h2; _h1 = _h1 * 5 + 0x52dce729;
+			k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; _h2 ^= k2;
+			_h2 = rotl(_h2, 31); _h2 += _h1; _h2 = _h2 * 5 + 0x38495ab5;
+		}
+
+		uint64_t _h1, _h2;
+		uint64_t _total_size = 0;
+		uint8_t _buffer[16];
+		size_t _buffer_size = 0;
+	};
+
+	/// <summary>
+	/// Calculates the 128-bit hash of the specified bytes in one go.
+	/// </summary>
+	inline hash128 hash(const std::string_view data, uint64_t seed = 0)
+	{
+		hasher h(seed);
+		h.update(data);
+		return h.finalize();
+	}
+}
@@ -5,8 +5,20 @@
 
 #include "effect_lexer.hpp"
 #include <cassert>
+#include <cstring> // std::memchr
 #include <unordered_map> // Used for static lookup tables
 
+// SSE2 is part of the baseline of all x64 processors (and enabled by default for x86 builds too), so no run-time detection is necessary
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+	#define RESHADEFX_LEXER_SSE2 1
+	#include <emmintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h> // _BitScanForward
+	#endif
+#else
+	#define RESHADEFX_LEXER_SSE2 0
+#endif
+
 using namespace reshadefx;
 
 enum token_type
@@ -495,6 +507,125 @@ static long long octal_to_decimal(long long n)
 	return n;
 }
 
+#pragma region Character scanning
+
+// The functions below return a pointer to the first character in the range [begin, end) that does not belong to the scanned sequence (or 'end' if all do).
+// They process 16 characters at a time where SSE2 is available and only fall back to looking at single characters for the remainder, so they never read past the end of the range.
+
+#if RESHADEFX_LEXER_SSE2
+static inline unsigned int first_set_bit(unsigned int mask)
+{
+	assert(mask != 0);
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// Compares each character against a range of values, which SSE2 can only do with signed comparisons, so shift everything into the signed range first
+static inline __m128i in_range(__m128i chars, char first, char last)
+{
+	const __m128i offset = _mm_sub_epi8(chars, _mm_set1_epi8(static_cast<char>(first + 128)));
+	return _mm_cmplt_epi8(offset, _mm_set1_epi8(static_cast<char>(last - first + 1 - 128)));
+}
+#endif
+
+static inline bool is_space(char c)
+{
+	// Everything the type lookup table considers a space character (which does not include the line feed, since it is a token by itself)
+	return c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r';
+}
+static inline bool is_identifier_char(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_decimal_digit(c) || c == '_';
+}
+
+static const char *find_end_of_space(const char *begin, const char *end)
+{
+#if RESHADEFX_LEXER_SSE2
+	for (; end - begin >= 16; begin += 16)
+	{
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+		const __m128i matches = _mm_or_si128(
+			_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+			_mm_andnot_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')), in_range(chars, '\t', '\r')));
+
+		if (const unsigned int mask = ~_mm_movemask_epi8(matches) & 0xFFFF)
+			return begin + first_set_bit(mask);
+	}
+#endif
+	while (begin < end && is_space(*begin))
+		++begin;
+	return begin;
+}
+static const char *find_end_of_identifier(const char *begin, const char *end)
+{
+#if RESHADEFX_LEXER_SSE2
+	for (; end - begin >= 16; begin += 16)
+	{
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+		const __m128i matches = _mm_or_si128(
+			_mm_or_si128(
+				in_range(_mm_or_si128(chars, _mm_set1_epi8(0x20)), 'a', 'z'), // Setting this bit converts upper case to lower case letters
+				in_range(chars, '0', '9')),
+			_mm_cmpeq_epi8(chars, _mm_set1_epi8('_')));
+
+		if (const unsigned int mask = ~_mm_movemask_epi8(matches) & 0xFFFF)
+			return begin + first_set_bit(mask);
+	}
+#endif
+	while (begin < end && is_identifier_char(*begin))
+		++begin;
+	return begin;
+}
+static const char *find_multi_line_comment_special(const char *begin, const char *end)
+{
+	// Only a '*' can start the end of a comment and line feeds need to be counted, everything else can be skipped
+#if RESHADEFX_LEXER_SSE2
+	for (; end - begin >= 16; begin += 16)
+	{
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+		const __m128i matches = _mm_or_si128(
+			_mm_cmpeq_epi8(chars, _mm_set1_epi8('*')),
+			_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+
+		if (const unsigned int mask = _mm_movemask_epi8(matches))
+			return begin + first_set_bit(mask);
+	}
+#endif
+	while (begin < end && *begin != '*' && *begin != '\n')
+		++begin;
+	return begin;
+}
+static const char *find_string_literal_special(const char *begin, const char *end)
+{
+	// Find the closing quote, the end of the line or any character that needs special handling
+#if RESHADEFX_LEXER_SSE2
+	for (; end - begin >= 16; begin += 16)
+	{
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+		const __m128i matches = _mm_or_si128(
+			_mm_or_si128(
+				_mm_cmpeq_epi8(chars, _mm_set1_epi8('"')),
+				_mm_cmpeq_epi8(chars, _mm_set1_epi8('\\'))),
+			_mm_or_si128(
+				_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')),
+				_mm_cmpeq_epi8(chars, _mm_set1_epi8('\r'))));
+
+		if (const unsigned int mask = _mm_movemask_epi8(matches))
+			return begin + first_set_bit(mask);
+	}
+#endif
+	while (begin < end && *begin != '"' && *begin != '\\' && *begin != '\n' && *begin != '\r')
+		++begin;
+	return begin;
+}
+
+#pragma endregion
+
 std::string reshadefx::token::id_to_name(tokenid id)
 {
 	const auto it = token_lookup.find(id);
@@ -648,6 +779,11 @@ next_token:
 		{
 			while (_cur < _end)
 			{
+				// Skip over all characters that cannot end the comment or start a new line in one go
+				skip(find_multi_line_comment_special(_cur, _end) - _cur);
+				if (_cur >= _end)
+					break;
+
 				if (*_cur == '\n')
 				{
 					_cur_location.line++;
@@ -775,21 +911,22 @@ void reshadefx::lexer::skip(size_t length)
 }
 void reshadefx::lexer::skip_space()
 {
-	// Skip each character until a space is found
-	while (type_lookup[uint8_t(*_cur)] == SPACE && _cur < _end)
-		skip(1);
+	// Skip each character until a non-space is found
+	skip(find_end_of_space(_cur, _end) - _cur);
 }
 void reshadefx::lexer::skip_to_next_line()
 {
 	// Skip each character until a new line feed is found
-	while (*_cur != '\n' && _cur < _end)
-		skip(1);
+	if (_cur >= _end)
+		return;
+	const auto line_end = static_cast<const char *>(std::memchr(_cur, '\n', _end - _cur));
+	skip((line_end != nullptr ? line_end : _end) - _cur);
 }
 
 void reshadefx::lexer::reset_to_offset(size_t offset)
 {
-	assert(offset < _input.size());
-	_cur = _input.data() + offset;
+	assert(offset < _input->size());
+	_cur = _input->data() + offset;
 }
 
 void reshadefx::lexer::parse_identifier(token &tok) const
@@ -797,7 +934,7 @@ void reshadefx::lexer::parse_identifier(token &tok) const
 	auto *const begin = _cur, *end = begin;
 
 	// Skip to the end of the identifier sequence
-	do end++; while (type_lookup[uint8_t(*end)] == IDENT || type_lookup[uint8_t(*end)] == DIGIT);
+	end = find_end_of_identifier(begin + 1, _end);
 
 	tok.id = tokenid::identifier;
 	tok.offset = input_offset();
@@ -861,6 +998,15 @@ void reshadefx::lexer::parse_string_literal(token &tok, bool escape)
 
 	for (auto c = *end; c != '"'; c = *++end)
 	{
+		// Append all characters up to the next one that needs special handling in one go
+		if (const char *const run_end = find_string_literal_special(end, _end); run_end != end)
+		{
+			tok.literal_as_string.append(end, run_end);
+			end = run_end;
+			if ((c = *end) == '"')
+				break;
+		}
+
 		if (c == '\n' || end >= _end)
 		{
 			// Line feed reached, the string literal is done (technically this should be an error, but the lexer does not report errors, so ignore it)
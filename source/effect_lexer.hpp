@@ -6,6 +6,7 @@
 #pragma once
 
 #include "effect_token.hpp"
+#include <memory> // std::shared_ptr
 
 namespace reshadefx
 {
@@ -24,6 +25,21 @@ namespace reshadefx
 			bool ignore_keywords = false,
 			bool escape_string_literals = true,
 			const location &start_location = location()) :
+			lexer(std::make_shared<const std::string>(std::move(input)), ignore_comments, ignore_whitespace, ignore_pp_directives, ignore_line_directives, ignore_keywords, escape_string_literals, start_location)
+		{
+		}
+		/// <summary>
+		/// Creates a lexical analyzer that works on a shared input string, without copying it.
+		/// </summary>
+		explicit lexer(
+			std::shared_ptr<const std::string> input,
+			bool ignore_comments = true,
+			bool ignore_whitespace = true,
+			bool ignore_pp_directives = true,
+			bool ignore_line_directives = false,
+			bool ignore_keywords = false,
+			bool escape_string_literals = true,
+			const location &start_location = location()) :
 			_input(std::move(input)),
 			_cur_location(start_location),
 			_ignore_comments(ignore_comments),
@@ -33,37 +49,26 @@ namespace reshadefx
 			_ignore_keywords(ignore_keywords),
 			_escape_string_literals(escape_string_literals)
 		{
-			_cur = _input.data();
-			_end = _cur + _input.size();
+			_cur = _input->data();
+			_end = _cur + _input->size();
 		}
 
-		lexer(const lexer &lexer) { operator=(lexer); }
-		lexer &operator=(const lexer &lexer)
-		{
-			_input = lexer._input;
-			_cur_location = lexer._cur_location;
-			reset_to_offset(lexer._cur - lexer._input.data());
-			_end = _input.data() + _input.size();
-			_ignore_comments = lexer._ignore_comments;
-			_ignore_whitespace = lexer._ignore_whitespace;
-			_ignore_pp_directives = lexer._ignore_pp_directives;
-			_ignore_keywords = lexer._ignore_keywords;
-			_escape_string_literals = lexer._escape_string_literals;
-			_ignore_line_directives = lexer._ignore_line_directives;
-
-			return *this;
-		}
+		// Copies share the input string (which is immutable), so the default copy operations suffice
 
 		/// <summary>
 		/// Get the current position in the input string.
 		/// </summary>
-		size_t input_offset() const { return _cur - _input.data(); }
+		size_t input_offset() const { return _cur - _input->data(); }
 
 		/// <summary>
 		/// Get the input string this lexical analyzer works on.
 		/// </summary>
 		/// <returns>A constant reference to the input string.</returns>
-		const std::string &input_string() const { return _input; }
+		const std::string &input_string() const { return *_input; }
+		/// <summary>
+		/// Get the shared buffer holding the input string, which can be used to keep it alive independent of this lexical analyzer.
+		/// </summary>
+		const std::shared_ptr<const std::string> &input_buffer() const { return _input; }
 
 		/// <summary>
 		/// Perform lexical analysis on the input string and return the next token in sequence.
@@ -98,7 +103,7 @@ namespace reshadefx
 		void parse_string_literal(token &tok, bool escape);
 		void parse_numeric_literal(token &tok) const;
 
-		std::string _input;
+		std::shared_ptr<const std::string> _input;
 		location _cur_location;
 		const std::string::value_type *_cur, *_end;
 		bool _ignore_comments;
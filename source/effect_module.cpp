@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "effect_module.hpp"
+#include <cstring> // memcpy
+
+static constexpr uint32_t s_module_format_magic = 0x58465352; // 'RSFX'
+// Increase this whenever the layout of any of the structures in 'effect_module.hpp' or the code generated by any of the backends changes
+static constexpr uint32_t s_module_format_version = 3;
+
+namespace
+{
+	struct module_writer
+	{
+		std::string &data;
+
+		void write(const void *value, size_t size)
+		{
+			data.append(static_cast<const char *>(value), size);
+		}
+
+		void write(bool value) { write(static_cast<uint8_t>(value)); }
+		void write(uint8_t value) { write(&value, sizeof(value)); }
+		void write(uint16_t value) { write(&value, sizeof(value)); }
+		void write(uint32_t value) { write(&value, sizeof(value)); }
+		void write(int32_t value) { write(&value, sizeof(value)); }
+		void write(float value) { write(&value, sizeof(value)); }
+
+		void write(const std::string &value)
+		{
+			write(static_cast<uint32_t>(value.size()));
+			write(value.data(), value.size());
+		}
+		template <typename T>
+		void write(const std::vector<T> &values)
+		{
+			write(static_cast<uint32_t>(values.size()));
+			for (const T &value : values)
+				write(value);
+		}
+
+		void write(const reshadefx::type &type)
+		{
+			write(static_cast<uint8_t>(type.base));
+			write(static_cast<uint32_t>(type.rows));
+			write(static_cast<uint32_t>(type.cols));
+			write(static_cast<uint32_t>(type.qualifiers));
+			write(static_cast<int32_t>(type.array_length));
+			write(type.definition);
+		}
+		void write(const reshadefx::constant &value)
+		{
+			write(value.as_uint, sizeof(value.as_uint));
+			write(value.string_data);
+			write(value.array_data);
+		}
+		void write(const reshadefx::annotation &annotation)
+		{
+			write(annotation.type);
+			write(annotation.name);
+			write(annotation.value);
+		}
+		void write(const reshadefx::entry_point &entry_point)
+		{
+			write(entry_point.name);
+			write(static_cast<uint8_t>(entry_point.type));
+			write(entry_point.spirv);
+			write(entry_point.hlsl);
+		}
+		void write(const reshadefx::texture_info &info)
+		{
+			write(info.id);
+			write(info.binding);
+			write(info.semantic);
+			write(info.unique_name);
+			write(info.annotations);
+			write(info.width);
+			write(info.height);
+			write(info.levels);
+			write(static_cast<uint8_t>(info.format));
+			write(info.render_target);
+			write(info.storage_access);
+		}
+		void write(const reshadefx::sampler_info &info)
+		{
+			write(info.id);
+			write(info.binding);
+			write(info.texture_binding);
+			write(info.unique_name);
+			write(info.texture_name);
+			write(info.annotations);
+			write(static_cast<uint8_t>(info.filter));
+			write(static_cast<uint8_t>(info.address_u));
+			write(static_cast<uint8_t>(info.address_v));
+			write(static_cast<uint8_t>(info.address_w));
+			write(info.min_lod);
+			write(info.max_lod);
+			write(info.lod_bias);
+			write(info.srgb);
+		}
+		void write(const reshadefx::storage_info &info)
+		{
+			write(info.id);
+			write(info.binding);
+			write(info.unique_name);
+			write(info.texture_name);
+		}
+		void write(const reshadefx::uniform_info &info)
+		{
+			write(info.name);
+			write(info.type);
+			write(info.size);
+			write(info.offset);
+			write(info.annotations);
+			write(info.has_initializer_value);
+			write(info.initializer_value);
+		}
+		void write(const reshadefx::pass_info &info)
+		{
+			write(info.name);
+			for (const std::string &render_target_name : info.render_target_names)
+				write(render_target_name);
+			write(info.vs_entry_point);
+			write(info.ps_entry_point);
+			write(info.cs_entry_point);
+			write(info.clear_render_targets);
+			write(info.srgb_write_enable);
+			write(info.blend_enable);
+			write(info.stencil_enable);
+			write(info.color_write_mask);
+			write(info.stencil_read_mask);
+			write(info.stencil_write_mask);
+			write(static_cast<uint8_t>(info.blend_op));
+			write(static_cast<uint8_t>(info.blend_op_alpha));
+			write(static_cast<uint8_t>(info.src_blend));
+			write(static_cast<uint8_t>(info.dest_blend));
+			write(static_cast<uint8_t>(info.src_blend_alpha));
+			write(static_cast<uint8_t>(info.dest_blend_alpha));
+			write(static_cast<uint8_t>(info.stencil_comparison_func));
+			write(info.stencil_reference_value);
+			write(static_cast<uint8_t>(info.stencil_op_pass));
+			write(static_cast<uint8_t>(info.stencil_op_fail));
+			write(static_cast<uint8_t>(info.stencil_op_depth_fail));
+			write(info.num_vertices);
+			write(static_cast<uint8_t>(info.topology));
+			write(info.viewport_width);
+			write(info.viewport_height);
+			write(info.viewport_dispatch_z);
+			write(info.samplers);
+			write(info.storages);
+		}
+		void write(const reshadefx::technique_info &info)
+		{
+			write(info.name);
+			write(info.passes);
+			write(info.annotations);
+		}
+	};
+
+	struct module_reader
+	{
+		const std::string &data;
+		size_t offset;
+		bool failed = false;
+
+		void read(void *value, size_t size)
+		{
+			if (failed || size > data.size() - offset)
+			{
+				failed = true;
+				std::memset(value, 0, size);
+				return;
+			}
+
+			std::memcpy(value, data.data() + offset, size);
+			offset += size;
+		}
+
+		template <typename T, typename S>
+		void read_as(T &value)
+		{
+			S stored;
+			read(&stored, sizeof(stored));
+			value = static_cast<T>(stored);
+		}
+
+		void read(bool &value) { read_as<bool, uint8_t>(value); }
+		void read(uint8_t &value) { read(&value, sizeof(value)); }
+		void read(uint16_t &value) { read(&value, sizeof(value)); }
+		void read(uint32_t &value) { read(&value, sizeof(value)); }
+		void read(int32_t &value) { read(&value, sizeof(value)); }
+		void read(float &value) { read(&value, sizeof(value)); }
+
+		void read(std::string &value)
+		{
+			uint32_t size = 0;
+			read(size);
+			if (failed || size > data.size() - offset)
+			{
+				failed = true;
+				return;
+			}
+
+			value.assign(data.data() + offset, size);
+			offset += size;
+		}
+		template <typename T>
+		void read(std::vector<T> &values)
+		{
+			uint32_t size = 0;
+			read(size);
+			// Each element occupies at least one byte, so this catches corrupted sizes before trying to allocate memory for them
+			if (failed || size > data.size() - offset)
+			{
+				failed = true;
+				return;
+			}
+
+			values.resize(size);
+			for (T &value : values)
+				read(value);
+		}
+
+		void read(reshadefx::type &type)
+		{
+			read_as<reshadefx::type::datatype, uint8_t>(type.base);
+			read_as<unsigned int, uint32_t>(type.rows);
+			read_as<unsigned int, uint32_t>(type.cols);
+			read_as<unsigned int, uint32_t>(type.qualifiers);
+			read_as<int, int32_t>(type.array_length);
+			read(type.definition);
+		}
+		void read(reshadefx::constant &value)
+		{
+			read(value.as_uint, sizeof(value.as_uint));
+			read(value.string_data);
+			read(value.array_data);
+		}
+		void read(reshadefx::annotation &annotation)
+		{
+			read(annotation.type);
+			read(annotation.name);
+			read(annotation.value);
+		}
+		void read(reshadefx::entry_point &entry_point)
+		{
+			read(entry_point.name);
+			read_as<reshadefx::shader_type, uint8_t>(entry_point.type);
+			read(entry_point.spirv);
+			read(entry_point.hlsl);
+		}
+		void read(reshadefx::texture_info &info)
+		{
+			read(info.id);
+			read(info.binding);
+			read(info.semantic);
+			read(info.unique_name);
+			read(info.annotations);
+			read(info.width);
+			read(info.height);
+			read(info.levels);
+			read_as<reshadefx::texture_format, uint8_t>(info.format);
+			read(info.render_target);
+			read(info.storage_access);
+		}
+		void read(reshadefx::sampler_info &info)
+		{
+			read(info.id);
+			read(info.binding);
+			read(info.texture_binding);
+			read(info.unique_name);
+			read(info.texture_name);
+			read(info.annotations);
+			read_as<reshadefx::filter_mode, uint8_t>(info.filter);
+			read_as<reshadefx::texture_address_mode, uint8_t>(info.address_u);
+			read_as<reshadefx::texture_address_mode, uint8_t>(info.address_v);
+			read_as<reshadefx::texture_address_mode, uint8_t>(info.address_w);
+			read(info.min_lod);
+			read(info.max_lod);
+			read(info.lod_bias);
+			read(info.srgb);
+		}
+		void read(reshadefx::storage_info &info)
+		{
+			read(info.id);
+			read(info.binding);
+			read(info.unique_name);
+			read(info.texture_name);
+		}
+		void read(reshadefx::uniform_info &info)
+		{
+			read(info.name);
+			read(info.type);
+			read(info.size);
+			read(info.offset);
+			read(info.annotations);
+			read(info.has_initializer_value);
+			read(info.initializer_value);
+		}
+		void read(reshadefx::pass_info &info)
+		{
+			read(info.name);
+			for (std::string &render_target_name : info.render_target_names)
+				read(render_target_name);
+			read(info.vs_entry_point);
+			read(info.ps_entry_point);
+			read(info.cs_entry_point);
+			read(info.clear_render_targets);
+			read(info.srgb_write_enable);
+			read(info.blend_enable);
+			read(info.stencil_enable);
+			read(info.color_write_mask);
+			read(info.stencil_read_mask);
+			read(info.stencil_write_mask);
+			read_as<reshadefx::pass_blend_op, uint8_t>(info.blend_op);
+			read_as<reshadefx::pass_blend_op, uint8_t>(info.blend_op_alpha);
+			read_as<reshadefx::pass_blend_func, uint8_t>(info.src_blend);
+			read_as<reshadefx::pass_blend_func, uint8_t>(info.dest_blend);
+			read_as<reshadefx::pass_blend_func, uint8_t>(info.src_blend_alpha);
+			read_as<reshadefx::pass_blend_func, uint8_t>(info.dest_blend_alpha);
+			read_as<reshadefx::pass_stencil_func, uint8_t>(info.stencil_comparison_func);
+			read(info.stencil_reference_value);
+			read_as<reshadefx::pass_stencil_op, uint8_t>(info.stencil_op_pass);
+			read_as<reshadefx::pass_stencil_op, uint8_t>(info.stencil_op_fail);
+			read_as<reshadefx::pass_stencil_op, uint8_t>(info.stencil_op_depth_fail);
+			read(info.num_vertices);
+			read_as<reshadefx::primitive_topology, uint8_t>(info.topology);
+			read(info.viewport_width);
+			read(info.viewport_height);
+			read(info.viewport_dispatch_z);
+			read(info.samplers);
+			read(info.storages);
+		}
+		void read(reshadefx::technique_info &info)
+		{
+			read(info.name);
+			read(info.passes);
+			read(info.annotations);
+		}
+	};
+}
+
+void reshadefx::serialize_module(const module &module, std::string &data)
+{
+	module_writer writer { data };
+
+	writer.write(s_module_format_magic);
+	writer.write(s_module_format_version);
+
+	writer.write(module.hlsl);
+	writer.write(module.spirv);
+	writer.write(module.entry_points);
+	writer.write(module.textures);
+	writer.write(module.samplers);
+	writer.write(module.storages);
+	writer.write(module.uniforms);
+	writer.write(module.spec_constants);
+	writer.write(module.techniques);
+	writer.write(module.total_uniform_size);
+	writer.write(module.num_texture_bindings);
+	writer.write(module.num_sampler_bindings);
+	writer.write(module.num_storage_bindings);
+}
+
+bool reshadefx::deserialize_module(module &module, const std::string &data, size_t &offset)
+{
+	module_reader reader { data, offset };
+
+	uint32_t magic = 0, version = 0;
+	reader.read(magic);
+	reader.read(version);
+	if (reader.failed || magic != s_module_format_magic || version != s_module_format_version)
+		return false;
+
+	reshadefx::module result;
+	reader.read(result.hlsl);
+	reader.read(result.spirv);
+	reader.read(result.entry_points);
+	reader.read(result.textures);
+	reader.read(result.samplers);
+	reader.read(result.storages);
+	reader.read(result.uniforms);
+	reader.read(result.spec_constants);
+	reader.read(result.techniques);
+	reader.read(result.total_uniform_size);
+	reader.read(result.num_texture_bindings);
+	reader.read(result.num_sampler_bindings);
+	reader.read(result.num_storage_bindings);
+	if (reader.failed)
+		return false;
+
+	module = std::move(result);
+	offset = reader.offset;
+	return true;
+}
@@ -242,6 +242,10 @@ namespace reshadefx
 	{
 		std::string name;
 		shader_type type;
+		// SPIR-V module containing only this entry point and the functions and variables it references (only filled in by the SPIR-V code generator)
+		std::vector<uint32_t> spirv;
+		// HLSL or GLSL code containing only this entry point and the functions and variables it references (only filled in by the HLSL and GLSL code generators)
+		std::string hlsl;
 	};
 
 	/// <summary>
@@ -326,4 +330,17 @@ namespace reshadefx
 		uint32_t num_sampler_bindings = 0;
 		uint32_t num_storage_bindings = 0;
 	};
+
+	/// <summary>
+	/// Appends a binary representation of the specified <paramref name="module"/> to <paramref name="data"/>, which can be stored on disk and loaded again via <see cref="deserialize_module"/>.
+	/// </summary>
+	void serialize_module(const module &module, std::string &data);
+	/// <summary>
+	/// Restores a module previously written by <see cref="serialize_module"/>.
+	/// </summary>
+	/// <param name="module">The module to fill. This is left untouched if loading fails.</param>
+	/// <param name="data">The binary data to read from.</param>
+	/// <param name="offset">The offset into <paramref name="data"/> to start reading at. This is advanced past the end of the module on success.</param>
+	/// <returns><see langword="true"/> if the module was restored successfully, <see langword="false"/> if the data is corrupted or was written by an incompatible version.</returns>
+	bool deserialize_module(module &module, const std::string &data, size_t &offset);
 }
@@ -12,6 +12,8 @@ namespace reshadefx
 {
 	/// <summary>
 	/// A parser for the ReShade FX shader language.
+	/// Code is generated while parsing, so the only optimizations done here are those that can be decided locally: Constant expressions are evaluated, and branches and conditional expressions with a constant condition are folded.
+	/// Constants are not propagated through non-const local variables and dead stores are not eliminated, since that would require an intermediate representation. This is left to the SPIR-V optimization passes (see 'create_codegen_spirv') and the shader compilers consuming the HLSL and GLSL output.
 	/// </summary>
 	class parser : symbol_table
 	{
@@ -1286,6 +1286,9 @@ bool reshadefx::parser::parse_expression_multary(expression &lhs, unsigned int l
 			// Constant expressions can be evaluated at compile time
 			if (rhs.is_constant && lhs.evaluate_constant_expression(op, rhs.constant))
 				continue;
+			// So can logical operations where the left-hand side alone already determines the result (e.g. "false && x")
+			if (lhs.is_constant && type.is_scalar() && (op == tokenid::ampersand_ampersand || op == tokenid::pipe_pipe) && (lhs.constant.as_uint[0] != 0) == (op == tokenid::pipe_pipe))
+				continue;
 
 			const auto lhs_value = _codegen->emit_load(lhs);
 
@@ -1385,6 +1388,29 @@ bool reshadefx::parser::parse_expression_multary(expression &lhs, unsigned int l
 			true_exp.add_cast_operation(type);
 			false_exp.add_cast_operation(type);
 
+#if !RESHADEFX_SHORT_CIRCUIT
+			// A constant condition that selects the same side for all components can be evaluated at compile time (and the result may be constant as well)
+			if (lhs.is_constant)
+			{
+				const bool condition = lhs.constant.as_uint[0] != 0;
+
+				bool is_uniform_condition = true;
+				for (unsigned int i = 1; i < lhs.type.rows; ++i)
+					is_uniform_condition &= (lhs.constant.as_uint[i] != 0) == condition;
+
+				if (is_uniform_condition)
+				{
+					expression &selected_exp = condition ? true_exp : false_exp;
+
+					if (selected_exp.is_constant)
+						lhs.reset_to_rvalue_constant(lhs.location, std::move(selected_exp.constant), type);
+					else
+						lhs.reset_to_rvalue(lhs.location, _codegen->emit_load(selected_exp), type);
+					continue;
+				}
+			}
+#endif
+
 			// Load condition value from expression
 			const auto condition_value = _codegen->emit_load(lhs);
 
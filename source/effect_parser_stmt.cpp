@@ -7,6 +7,7 @@
 #include "effect_parser.hpp"
 #include "effect_codegen.hpp"
 #include <cassert>
+#include <limits>
 #include <functional>
 
 struct on_scope_exit
@@ -221,20 +222,38 @@ bool reshadefx::parser::parse_statement(bool scoped)
 			const codegen::id condition_value = _codegen->emit_load(condition);
 			const codegen::id condition_block = _codegen->leave_block_and_branch_conditional(condition_value, true_block, false_block);
 
+			// Statements that can never be executed because of a constant condition still have to be parsed, but are parsed into a separate block that is never branched to, so that they can be dropped from the output
+			const bool is_true_block_dead = condition.is_constant && condition.constant.as_uint[0] == 0;
+			const bool is_false_block_dead = condition.is_constant && condition.constant.as_uint[0] != 0;
+
 			{ // Then block of the if statement
-				_codegen->enter_block(true_block);
+				_codegen->enter_block(is_true_block_dead ? _codegen->create_block() : true_block);
 
 				if (!parse_statement(true))
 					return false;
 
+				if (is_true_block_dead)
+				{
+					// Continue with an empty block in place of the dead one
+					_codegen->leave_block_and_branch(merge_block);
+					_codegen->enter_block(true_block);
+				}
+
 				true_block = _codegen->leave_block_and_branch(merge_block);
 			}
 			{ // Else block of the if statement
-				_codegen->enter_block(false_block);
+				_codegen->enter_block(is_false_block_dead ? _codegen->create_block() : false_block);
 
 				if (accept(tokenid::else_) && !parse_statement(true))
 					return false;
 
+				if (is_false_block_dead)
+				{
+					// Continue with an empty block in place of the dead one
+					_codegen->leave_block_and_branch(merge_block);
+					_codegen->enter_block(false_block);
+				}
+
 				false_block = _codegen->leave_block_and_branch(merge_block);
 			}
 
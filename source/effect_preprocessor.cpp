@@ -5,7 +5,9 @@
 
 #include "effect_lexer.hpp"
 #include "effect_preprocessor.hpp"
+#include "effect_hash.hpp"
 #include <cassert>
+#include <mutex>
 #include <algorithm> // std::find_if
 
 #ifndef _WIN32
@@ -98,6 +100,59 @@ static bool read_file(const std::filesystem::path &path, std::string &data)
 	return true;
 }
 
+void reshadefx::source_file_cache::clear()
+{
+	const std::unique_lock<std::mutex> lock(_mutex);
+	_files.clear();
+}
+
+std::shared_ptr<const std::string> reshadefx::source_file_cache::read(const std::filesystem::path &path)
+{
+	std::error_code ec;
+	const uintmax_t size = std::filesystem::file_size(path, ec);
+	if (ec)
+		return nullptr;
+	const std::filesystem::file_time_type last_write_time = std::filesystem::last_write_time(path, ec);
+	if (ec)
+		return nullptr;
+
+	{	const std::unique_lock<std::mutex> lock(_mutex);
+
+		if (const auto it = _files.find(path.native());
+			it != _files.end() && it->second.size == size && it->second.last_write_time == last_write_time)
+			return it->second.data;
+	}
+
+	// Read file without holding the lock, so that other threads can continue to access the cache in the meantime
+	std::string data;
+	if (!read_file(path, data))
+		return nullptr;
+
+	auto shared_data = std::make_shared<const std::string>(std::move(data));
+
+	{	const std::unique_lock<std::mutex> lock(_mutex);
+
+		_files[path.native()] = { size, last_write_time, shared_data };
+	}
+
+	return shared_data;
+}
+
+static uint64_t hash_macro(const std::string &name, const reshadefx::preprocessor::macro &macro)
+{
+	reshadefx::hasher hasher;
+	hasher.update(name);
+	hasher.update(static_cast<uint64_t>(macro.replacement_list.size()));
+	hasher.update(macro.replacement_list);
+	for (const std::string &parameter : macro.parameters)
+	{
+		hasher.update(static_cast<uint64_t>(parameter.size()));
+		hasher.update(parameter);
+	}
+	hasher.update(static_cast<uint64_t>(macro.is_variadic) | (static_cast<uint64_t>(macro.is_function_like) << 1));
+	return hasher.finalize().low;
+}
+
 static std::string escape_string(std::string s)
 {
 	for (size_t offset = 0; (offset = s.find('\\', offset)) != std::string::npos; offset += 2)
@@ -105,6 +160,73 @@ static std::string escape_string(std::string s)
 	return '\"' + s + '\"';
 }
 
+struct reshadefx::include_snapshot
+{
+	struct file
+	{
+		std::string path;
+		// Whether the file was already in the file cache when it was first included while recording the snapshot
+		bool was_cached;
+		// Hash of the file contents that were pushed when it was first included
+		hash128 content_hash;
+		// Contents of the file cache entry after processing (these differ from the actual file contents for files with '#pragma once')
+		std::shared_ptr<const std::string> data;
+	};
+
+	std::string path;
+	uint64_t state_hash = 0;
+
+	// All files that were included while processing this snapshot, starting with the file the snapshot was recorded for
+	std::vector<file> files;
+	std::unordered_set<std::string> used_macros;
+	std::set<std::pair<std::string, std::string>> include_lookups;
+	std::unordered_map<std::string, preprocessor::macro> macros;
+	uint64_t macros_hash = 0;
+	std::string output;
+	std::string errors;
+	location output_location;
+
+	// Offsets into the preprocessor output at the start of recording
+	size_t output_offset = 0;
+	size_t errors_offset = 0;
+};
+
+void reshadefx::include_snapshot_cache::clear()
+{
+	const std::unique_lock<std::mutex> lock(_mutex);
+	_snapshots.clear();
+}
+
+std::shared_ptr<const reshadefx::include_snapshot> reshadefx::include_snapshot_cache::find(const std::string &path, uint64_t state_hash) const
+{
+	const std::unique_lock<std::mutex> lock(_mutex);
+
+	if (const auto it = _snapshots.find(path); it != _snapshots.end())
+		for (const std::shared_ptr<const include_snapshot> &snapshot : it->second)
+			if (snapshot->state_hash == state_hash)
+				return snapshot;
+
+	return nullptr;
+}
+void reshadefx::include_snapshot_cache::insert(std::shared_ptr<const include_snapshot> snapshot)
+{
+	const std::unique_lock<std::mutex> lock(_mutex);
+
+	std::vector<std::shared_ptr<const include_snapshot>> &snapshots = _snapshots[snapshot->path];
+
+	// Replace any existing snapshot for the same state (e.g. in case file contents changed in the meantime)
+	for (std::shared_ptr<const include_snapshot> &existing_snapshot : snapshots)
+	{
+		if (existing_snapshot->state_hash == snapshot->state_hash)
+		{
+			existing_snapshot = std::move(snapshot);
+			return;
+		}
+	}
+
+	snapshots.push_back(std::move(snapshot));
+}
+
 reshadefx::preprocessor::preprocessor()
 {
 }
@@ -120,13 +242,18 @@ void reshadefx::preprocessor::add_include_path(const std::filesystem::path &path
 bool reshadefx::preprocessor::add_macro_definition(const std::string &name, const macro &macro)
 {
 	assert(!name.empty());
-	return _macros.emplace(name, macro).second;
+
+	if (!_macros.emplace(name, macro).second)
+		return false;
+
+	_macros_hash += hash_macro(name, macro);
+	return true;
 }
 
 bool reshadefx::preprocessor::append_file(const std::filesystem::path &path)
 {
-	std::string data;
-	if (!read_file(path, data))
+	std::shared_ptr<const std::string> data = read_source_file(path);
+	if (data == nullptr)
 		return false;
 
 	_success = true; // Clear success flag before parsing a new file
@@ -160,6 +287,14 @@ std::vector<std::filesystem::path> reshadefx::preprocessor::included_files() con
 		files.push_back(std::filesystem::u8path(it.first));
 	return files;
 }
+std::vector<std::pair<std::filesystem::path, std::filesystem::path>> reshadefx::preprocessor::include_lookups() const
+{
+	std::vector<std::pair<std::filesystem::path, std::filesystem::path>> lookups;
+	lookups.reserve(_include_lookups.size());
+	for (const std::pair<std::string, std::string> &lookup : _include_lookups)
+		lookups.emplace_back(std::filesystem::u8path(lookup.first), std::filesystem::u8path(lookup.second));
+	return lookups;
+}
 std::vector<std::pair<std::string, std::string>> reshadefx::preprocessor::used_macro_definitions() const
 {
 	std::vector<std::pair<std::string, std::string>> defines;
@@ -183,6 +318,10 @@ void reshadefx::preprocessor::warning(const location &location, const std::strin
 }
 
 void reshadefx::preprocessor::push(std::string input, const std::string &name)
+{
+	push(std::make_shared<const std::string>(std::move(input)), name);
+}
+void reshadefx::preprocessor::push(std::shared_ptr<const std::string> input, const std::string &name)
 {
 	location start_location = !name.empty() ?
 		// Start at the beginning of the file when pushing a new file
@@ -190,7 +329,8 @@ void reshadefx::preprocessor::push(std::string input, const std::string &name)
 		// Start with last known token location when pushing an unnamed string
 		_token.location;
 
-	input_level level = { name };
+	input_level level = {};
+	level.name = name;
 	level.lexer.reset(new lexer(
 		std::move(input),
 		true  /* ignore_comments */,
@@ -214,6 +354,27 @@ void reshadefx::preprocessor::push(std::string input, const std::string &name)
 	consume();
 }
 
+void reshadefx::preprocessor::pop()
+{
+	// Complete snapshot of an include file once its input level is done (unless errors occurred while processing it)
+	if (const std::shared_ptr<include_snapshot> snapshot = std::move(_input_stack.back().snapshot);
+		snapshot != nullptr && _success)
+	{
+		snapshot->output = _output.substr(snapshot->output_offset);
+		snapshot->errors = _errors.substr(snapshot->errors_offset);
+		snapshot->output_location = _output_location;
+		snapshot->macros = _macros;
+		snapshot->macros_hash = _macros_hash;
+
+		for (include_snapshot::file &file : snapshot->files)
+			file.data = _file_cache.at(file.path);
+
+		_include_snapshots->insert(snapshot);
+	}
+
+	_input_stack.pop_back();
+}
+
 bool reshadefx::preprocessor::peek(tokenid token) const
 {
 	return _input_stack[_next_input_index].next_token == token;
@@ -231,7 +392,7 @@ bool reshadefx::preprocessor::consume()
 
 	// Clear out input stack, now that the current token is overwritten
 	while (_input_stack.size() > (_current_input_index + 1))
-		_input_stack.pop_back();
+		pop();
 
 	// Update location information after switching input levels
 	input_level &input = _input_stack[_current_input_index];
@@ -244,7 +405,10 @@ bool reshadefx::preprocessor::consume()
 
 	// Set current token
 	_token = std::move(input.next_token);
-	_current_token_raw_data = input.lexer->input_string().substr(_token.offset, _token.length);
+	// Keep the input buffer alive for as long as the raw data of the current token may be referenced, since input levels can be popped in the meantime
+	if (_current_token_input != input.lexer->input_buffer())
+		_current_token_input = input.lexer->input_buffer();
+	_current_token_raw_data = std::string_view(*_current_token_input).substr(_token.offset, _token.length);
 
 	// Get the next token
 	input.next_token = input.lexer->lex();
@@ -264,7 +428,7 @@ bool reshadefx::preprocessor::consume()
 		if (_next_input_index == 0)
 		{
 			// End of input has been reached, so cannot pop further and this is the last token
-			_input_stack.pop_back();
+			pop();
 			return false;
 		}
 		else
@@ -479,7 +643,11 @@ void reshadefx::preprocessor::parse_undef()
 	else if (_token.literal_as_string == "defined")
 		return warning(_token.location, "macro name 'defined' is reserved");
 
-	_macros.erase(_token.literal_as_string);
+	if (const auto it = _macros.find(_token.literal_as_string); it != _macros.end())
+	{
+		_macros_hash -= hash_macro(it->first, it->second);
+		_macros.erase(it);
+	}
 }
 
 void reshadefx::preprocessor::parse_if()
@@ -517,7 +685,7 @@ void reshadefx::preprocessor::parse_ifdef()
 
 	_if_stack.push_back(std::move(level));
 	if (!parent_skipping) // Only add if this #ifdef is active
-		_used_macros.emplace(_token.literal_as_string);
+		add_used_macro(_token.literal_as_string);
 }
 void reshadefx::preprocessor::parse_ifndef()
 {
@@ -539,7 +707,7 @@ void reshadefx::preprocessor::parse_ifndef()
 
 	_if_stack.push_back(std::move(level));
 	if (!parent_skipping) // Only add if this #ifndef is active
-		_used_macros.emplace(_token.literal_as_string);
+		add_used_macro(_token.literal_as_string);
 }
 void reshadefx::preprocessor::parse_elif()
 {
@@ -621,7 +789,7 @@ void reshadefx::preprocessor::parse_pragma()
 	if (pragma == "once")
 	{
 		if (const auto it = _file_cache.find(_output_location.source); it != _file_cache.end())
-			it->second.clear();
+			it->second = std::make_shared<const std::string>();
 		return;
 	}
 
@@ -648,15 +816,7 @@ void reshadefx::preprocessor::parse_include()
 		return;
 	}
 
-	std::filesystem::path file_name = std::filesystem::u8path(_token.literal_as_string);
-	std::filesystem::path file_path = std::filesystem::u8path(_output_location.source);
-	file_path.replace_filename(file_name);
-
-	if (std::error_code ec; !std::filesystem::exists(file_path, ec))
-		for (const std::filesystem::path &include_path : _include_paths)
-			if (std::filesystem::exists(file_path = include_path / file_name, ec))
-				break;
-
+	const std::filesystem::path file_path = resolve_include(std::filesystem::u8path(_token.literal_as_string));
 	const std::string file_path_string = file_path.u8string();
 
 	// Detect recursive include and abort to avoid infinite loop
@@ -667,15 +827,29 @@ void reshadefx::preprocessor::parse_include()
 		return;
 	}
 
-	std::string data;
-	if (auto it = _file_cache.find(file_path_string);
-		it != _file_cache.end())
+	// Skip processing the file altogether if it was processed before with the same state in another preprocessor instance
+	if (_include_snapshots != nullptr && _success)
+	{
+		if (const std::shared_ptr<const include_snapshot> snapshot = find_include_snapshot(file_path_string))
+		{
+			while (_input_stack.size() > (_next_input_index + 1))
+				pop();
+			apply_include_snapshot(*snapshot);
+			return;
+		}
+	}
+
+	std::shared_ptr<const std::string> data;
+	const auto cache_it = _file_cache.find(file_path_string);
+	const bool was_cached = cache_it != _file_cache.end();
+	if (was_cached)
 	{
-		data = it->second;
+		data = cache_it->second;
 	}
 	else
 	{
-		if (!read_file(file_path, data))
+		data = read_source_file(file_path);
+		if (data == nullptr)
 		{
 			error(keyword_location, "could not open included file '" + file_path_string + '\'');
 			consume_until(tokenid::end_of_line);
@@ -687,8 +861,148 @@ void reshadefx::preprocessor::parse_include()
 
 	// Clear out input stack before pushing include so that hidden macros do not bleed into the include
 	while (_input_stack.size() > (_next_input_index + 1))
-		_input_stack.pop_back();
+		pop();
+
+	add_included_file_to_snapshots(file_path_string, was_cached, data);
+
+	// Start recording a new snapshot, which is completed when the input level of this include file is popped again
+	std::shared_ptr<include_snapshot> snapshot;
+	if (_include_snapshots != nullptr && _success)
+	{
+		snapshot = std::make_shared<include_snapshot>();
+		snapshot->path = file_path_string;
+		snapshot->state_hash = snapshot_state_hash();
+		snapshot->files.push_back({ file_path_string, was_cached, reshadefx::hash(*data), nullptr });
+		snapshot->output_offset = _output.size();
+		snapshot->errors_offset = _errors.size();
+	}
+
 	push(std::move(data), file_path_string);
+
+	if (snapshot != nullptr)
+		_input_stack.back().snapshot = std::move(snapshot);
+}
+
+uint64_t reshadefx::preprocessor::snapshot_state_hash() const
+{
+	// Include paths affect which files nested includes resolve to
+	reshadefx::hasher hasher;
+	hasher.update(_macros_hash);
+	for (const std::filesystem::path &include_path : _include_paths)
+		hasher.update(include_path.u8string());
+	return hasher.finalize().low;
+}
+std::shared_ptr<const reshadefx::include_snapshot> reshadefx::preprocessor::find_include_snapshot(const std::string &path) const
+{
+	std::shared_ptr<const include_snapshot> snapshot = _include_snapshots->find(path, snapshot_state_hash());
+	if (snapshot == nullptr)
+		return nullptr;
+
+	// Verify that all files would be included with the same contents again
+	for (const include_snapshot::file &file : snapshot->files)
+	{
+		// Files that are currently being processed would cause a recursive include error
+		if (std::find_if(_input_stack.begin(), _input_stack.end(),
+			[&file](const input_level &level) { return level.name == file.path; }) != _input_stack.end())
+			return nullptr;
+
+		hash128 content_hash;
+		if (const auto it = _file_cache.find(file.path); it != _file_cache.end())
+		{
+			if (!file.was_cached)
+				return nullptr;
+			content_hash = reshadefx::hash(*it->second);
+		}
+		else
+		{
+			std::shared_ptr<const std::string> data;
+			if (file.was_cached || (data = read_source_file(std::filesystem::u8path(file.path))) == nullptr)
+				return nullptr;
+			content_hash = reshadefx::hash(*data);
+		}
+
+		if (content_hash != file.content_hash)
+			return nullptr;
+	}
+
+	return snapshot;
+}
+void reshadefx::preprocessor::apply_include_snapshot(const include_snapshot &snapshot)
+{
+	_output += snapshot.output;
+	_errors += snapshot.errors;
+	_output_location = snapshot.output_location;
+
+	_macros = snapshot.macros;
+	_macros_hash = snapshot.macros_hash;
+
+	for (const include_snapshot::file &file : snapshot.files)
+	{
+		add_included_file_to_snapshots(file.path, file.was_cached, file.data);
+		_file_cache[file.path] = file.data;
+	}
+
+	for (const std::string &name : snapshot.used_macros)
+		add_used_macro(name);
+	for (const std::pair<std::string, std::string> &lookup : snapshot.include_lookups)
+		add_include_lookup(lookup);
+}
+void reshadefx::preprocessor::add_included_file_to_snapshots(const std::string &path, bool was_cached, const std::shared_ptr<const std::string> &data)
+{
+	for (const input_level &level : _input_stack)
+	{
+		if (level.snapshot == nullptr ||
+			// Only the state of the file when it was first included matters
+			std::find_if(level.snapshot->files.begin(), level.snapshot->files.end(),
+				[&path](const include_snapshot::file &file) { return file.path == path; }) != level.snapshot->files.end())
+			continue;
+
+		level.snapshot->files.push_back({ path, was_cached, reshadefx::hash(*data), nullptr });
+	}
+}
+void reshadefx::preprocessor::add_used_macro(const std::string &name)
+{
+	_used_macros.insert(name);
+
+	for (const input_level &level : _input_stack)
+		if (level.snapshot != nullptr)
+			level.snapshot->used_macros.insert(name);
+}
+void reshadefx::preprocessor::add_include_lookup(const std::pair<std::string, std::string> &lookup)
+{
+	_include_lookups.insert(lookup);
+
+	for (const input_level &level : _input_stack)
+		if (level.snapshot != nullptr)
+			level.snapshot->include_lookups.insert(lookup);
+}
+
+std::shared_ptr<const std::string> reshadefx::preprocessor::read_source_file(const std::filesystem::path &path) const
+{
+	if (_source_files != nullptr)
+		return _source_files->read(path);
+
+	std::string data;
+	if (!read_file(path, data))
+		return nullptr;
+
+	return std::make_shared<const std::string>(std::move(data));
+}
+std::filesystem::path reshadefx::preprocessor::resolve_include(const std::filesystem::path &file_name)
+{
+	// Look for the file next to the including file first, then in the include paths in order
+	std::filesystem::path file_path = std::filesystem::u8path(_output_location.source);
+	file_path.replace_filename(file_name);
+
+	// Keep track of the lookup, since a file added to an earlier location later on changes what this resolves to
+	add_include_lookup({ file_path.u8string(), file_name.u8string() });
+
+	if (std::error_code ec; !std::filesystem::exists(file_path, ec))
+		for (const std::filesystem::path &include_path : _include_paths)
+			if (std::filesystem::exists(file_path = include_path / file_name, ec))
+				break;
+
+	return file_path;
 }
 
 bool reshadefx::preprocessor::evaluate_expression()
@@ -852,18 +1166,12 @@ bool reshadefx::preprocessor::evaluate_expression()
 				}
 				if (!expect(tokenid::string_literal))
 					return false;
-				std::filesystem::path file_name = std::filesystem::u8path(_token.literal_as_string);
+				const std::filesystem::path file_name = std::filesystem::u8path(_token.literal_as_string);
 				if (has_parentheses && !expect(tokenid::parenthesis_close))
 					return false;
-				std::filesystem::path file_path = std::filesystem::u8path(_output_location.source);
-				file_path.replace_filename(file_name);
+				const std::filesystem::path file_path = resolve_include(file_name);
 
 				std::error_code ec;
-				if (!std::filesystem::exists(file_path, ec))
-					for (const std::filesystem::path &include_path : _include_paths)
-						if (std::filesystem::exists(file_path = include_path / file_name, ec))
-							break;
-
 				rpn[rpn_index++] = { std::filesystem::exists(file_path, ec) ? 1 : 0, false };
 				continue;
 			}
@@ -1137,6 +1445,10 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 
 void reshadefx::preprocessor::expand_macro(const std::string &name, const macro &macro, const std::vector<std::string> &arguments, std::string &out)
 {
+	// Arguments are completely macro-expanded before they are substituted (like in the C preprocessor), so only need to do that once per argument, no matter how often it is referenced
+	std::vector<std::string> expanded_arguments(arguments.size());
+	std::vector<bool> expanded_arguments_valid(arguments.size(), false);
+
 	for (size_t offset = 0; offset < macro.replacement_list.size(); ++offset)
 	{
 		if (macro.replacement_list[offset] != macro_replacement_start)
@@ -1181,18 +1493,26 @@ void reshadefx::preprocessor::expand_macro(const std::string &name, const macro
 			out += '"';
 			break;
 		case macro_replacement_argument:
-			push(arguments[index] + static_cast<char>(macro_replacement_argument));
-			while (true)
+			if (!expanded_arguments_valid[index])
 			{
-				// Consume all tokens here, so spaces are added to the output too
-				consume();
-				if (_token == tokenid::unknown) // 'macro_replacement_argument' is 'tokenid::unknown'
-					break;
-				if (_token == tokenid::identifier && evaluate_identifier_as_macro())
-					continue;
-				out += _current_token_raw_data;
+				std::string &expanded_argument = expanded_arguments[index];
+
+				push(arguments[index] + static_cast<char>(macro_replacement_argument));
+				while (true)
+				{
+					// Consume all tokens here, so spaces are added to the output too
+					consume();
+					if (_token == tokenid::unknown) // 'macro_replacement_argument' is 'tokenid::unknown'
+						break;
+					if (_token == tokenid::identifier && evaluate_identifier_as_macro())
+						continue;
+					expanded_argument += _current_token_raw_data;
+				}
+				assert(_current_token_raw_data[0] == macro_replacement_argument);
+
+				expanded_arguments_valid[index] = true;
 			}
-			assert(_current_token_raw_data[0] == macro_replacement_argument);
+			out += expanded_arguments[index];
 			break;
 		}
 	}
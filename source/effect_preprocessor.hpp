@@ -6,13 +6,71 @@
 #pragma once
 
 #include "effect_token.hpp"
-#include <memory> // std::unique_ptr
+#include <set>
+#include <mutex>
+#include <memory> // std::unique_ptr, std::shared_ptr
 #include <filesystem>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 
 namespace reshadefx
 {
+	/// <summary>
+	/// The state of a preprocessor after processing an included file (see 'effect_preprocessor.cpp').
+	/// </summary>
+	struct include_snapshot;
+
+	/// <summary>
+	/// A thread-safe store of include file snapshots, which can be shared by multiple preprocessor instances.
+	/// When a preprocessor encounters an include file with a matching snapshot (same file contents, macro definitions and include paths), it resumes from the snapshot instead of processing that file again.
+	/// </summary>
+	class include_snapshot_cache
+	{
+	public:
+		/// <summary>
+		/// Removes all snapshots from the cache.
+		/// </summary>
+		void clear();
+
+	private:
+		friend class preprocessor;
+
+		std::shared_ptr<const include_snapshot> find(const std::string &path, uint64_t state_hash) const;
+		void insert(std::shared_ptr<const include_snapshot> snapshot);
+
+		mutable std::mutex _mutex;
+		std::unordered_map<std::string, std::vector<std::shared_ptr<const include_snapshot>>> _snapshots;
+	};
+
+	/// <summary>
+	/// A thread-safe store of file contents, which can be shared by multiple preprocessor instances, so that files included by many effects are only read from disk once.
+	/// Cached contents are reused for as long as the size and last modification time of a file stay the same.
+	/// </summary>
+	class source_file_cache
+	{
+	public:
+		/// <summary>
+		/// Removes all files from the cache.
+		/// </summary>
+		void clear();
+
+	private:
+		friend class preprocessor;
+
+		struct cached_file
+		{
+			uintmax_t size;
+			std::filesystem::file_time_type last_write_time;
+			std::shared_ptr<const std::string> data;
+		};
+
+		std::shared_ptr<const std::string> read(const std::filesystem::path &path);
+
+		std::mutex _mutex;
+		std::unordered_map<std::filesystem::path::string_type, cached_file> _files;
+	};
+
 	/// <summary>
 	/// A C-style preprocessor implementation.
 	/// </summary>
@@ -37,6 +95,18 @@ namespace reshadefx
 		/// <param name="path">The path to the directory to add.</param>
 		void add_include_path(const std::filesystem::path &path);
 
+		/// <summary>
+		/// Set the cache to look up snapshots of include files in and add new ones to.
+		/// The cache may be shared with preprocessor instances on other threads. It only validates file contents, so it should not be kept around across changes to the set of files in the include paths.
+		/// </summary>
+		/// <param name="cache">The cache to use, which has to stay alive as long as this preprocessor instance, or <see langword="nullptr"/> to disable snapshots.</param>
+		void set_include_snapshot_cache(include_snapshot_cache *cache) { _include_snapshots = cache; }
+		/// <summary>
+		/// Set the cache to read files through.
+		/// </summary>
+		/// <param name="cache">The cache to use, which has to stay alive as long as this preprocessor instance, or <see langword="nullptr"/> to always read files from disk.</param>
+		void set_source_file_cache(source_file_cache *cache) { _source_files = cache; }
+
 		/// <summary>
 		/// Add a new macro definition. This is equal to appending '#define name macro' to this preprocessor instance.
 		/// </summary>
@@ -83,6 +153,10 @@ namespace reshadefx
 		/// Get a list of all included files.
 		/// </summary>
 		std::vector<std::filesystem::path> included_files() const;
+		/// <summary>
+		/// Get a list of all file names that were looked up by #include directives or '__has_include', together with the path that was tried first (relative to the including file) before falling back to the include paths.
+		/// </summary>
+		std::vector<std::pair<std::filesystem::path, std::filesystem::path>> include_lookups() const;
 
 		/// <summary>
 		/// Get a list of all defines that were used in #ifdef and #ifndef lines
@@ -104,12 +178,16 @@ namespace reshadefx
 			std::unique_ptr<class lexer> lexer;
 			token next_token;
 			std::unordered_set<std::string> hidden_macros;
+			// Snapshot that is being recorded while processing this include file
+			std::shared_ptr<include_snapshot> snapshot;
 		};
 
 		void error(const location &location, const std::string &message);
 		void warning(const location &location, const std::string &message);
 
 		void push(std::string input, const std::string &name = std::string());
+		void push(std::shared_ptr<const std::string> input, const std::string &name = std::string());
+		void pop();
 
 		bool peek(tokenid token) const;
 		bool consume();
@@ -134,12 +212,23 @@ namespace reshadefx
 		bool evaluate_expression();
 		bool evaluate_identifier_as_macro();
 
+		uint64_t snapshot_state_hash() const;
+		std::shared_ptr<const include_snapshot> find_include_snapshot(const std::string &path) const;
+		void apply_include_snapshot(const include_snapshot &snapshot);
+		void add_included_file_to_snapshots(const std::string &path, bool was_cached, const std::shared_ptr<const std::string> &data);
+		void add_used_macro(const std::string &name);
+		void add_include_lookup(const std::pair<std::string, std::string> &lookup);
+		std::shared_ptr<const std::string> read_source_file(const std::filesystem::path &path) const;
+		std::filesystem::path resolve_include(const std::filesystem::path &file_name);
+
 		void expand_macro(const std::string &name, const macro &macro, const std::vector<std::string> &arguments, std::string &out);
 		void create_macro_replacement_list(macro &macro);
 
 		bool _success = true;
 		std::string _output, _errors;
-		std::string _current_token_raw_data;
+		// View into the input of the current token (which is kept alive by holding on to its buffer)
+		std::string_view _current_token_raw_data;
+		std::shared_ptr<const std::string> _current_token_input;
 		reshadefx::token _token;
 		std::vector<if_level> _if_stack;
 		std::vector<input_level> _input_stack;
@@ -148,8 +237,14 @@ namespace reshadefx
 		unsigned short _recursion_count = 0;
 		location _output_location;
 		std::unordered_set<std::string> _used_macros;
+		std::set<std::pair<std::string, std::string>> _include_lookups;
 		std::unordered_map<std::string, macro> _macros;
+		// Order-independent hash of all macro definitions in the table above
+		uint64_t _macros_hash = 0;
 		std::vector<std::filesystem::path> _include_paths;
-		std::unordered_map<std::string, std::string> _file_cache;
+		// Contents of all included files, shared with the lexers working on them
+		std::unordered_map<std::string, std::shared_ptr<const std::string>> _file_cache;
+		include_snapshot_cache *_include_snapshots = nullptr;
+		source_file_cache *_source_files = nullptr;
 	};
 }
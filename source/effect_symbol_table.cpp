@@ -6,7 +6,8 @@
 #include "effect_symbol_table.hpp"
 #include <cassert>
 #include <malloc.h> // alloca
-#include <algorithm> // std::upper_bound, std::sort
+#include <algorithm> // std::upper_bound, std::sort, std::find_if
+#include <string_view>
 
 #pragma region Import intrinsic functions
 
@@ -113,6 +114,29 @@ static const intrinsic s_intrinsics[] =
 #undef sampler
 #undef storage
 
+/// <summary>
+/// Returns the range of overloads in <see cref="s_intrinsics"/> with the specified name.
+/// </summary>
+static std::pair<const intrinsic *, const intrinsic *> find_intrinsic_overloads(const std::string_view name)
+{
+	// Overloads of an intrinsic are defined next to each other, so they can be indexed by name with just the start and end of their range in the table
+	static const std::unordered_map<std::string_view, std::pair<size_t, size_t>> s_intrinsic_lookup = []() {
+		std::unordered_map<std::string_view, std::pair<size_t, size_t>> lookup;
+		for (size_t i = 0; i < std::size(s_intrinsics); ++i)
+		{
+			const auto it = lookup.try_emplace(s_intrinsics[i].function.name, i, i).first;
+			assert(it->second.second == i); // Overloads have to be contiguous in the table
+			it->second.second = i + 1;
+		}
+		return lookup;
+	}();
+
+	if (const auto it = s_intrinsic_lookup.find(name); it != s_intrinsic_lookup.end())
+		return { s_intrinsics + it->second.first, s_intrinsics + it->second.second };
+	else
+		return { nullptr, nullptr };
+}
+
 #pragma endregion
 
 unsigned int reshadefx::type::rank(const type &src, const type &dst)
@@ -176,22 +200,19 @@ void reshadefx::symbol_table::leave_scope()
 {
 	assert(_current_scope.level > 0);
 
-	for (auto &symbol : _symbol_stack)
+	// Only remove the symbols that were added in this scope, instead of walking through the entire symbol stack
+	while (!_local_symbols.empty() && _local_symbols.back().first >= _current_scope.level)
 	{
-		std::vector<scoped_symbol> &scope_list = symbol.second;
+		std::vector<scoped_symbol> &scope_list = *_local_symbols.back().second;
 
-		for (auto scope_it = scope_list.begin(); scope_it != scope_list.end();)
-		{
-			if (scope_it->scope.level > scope_it->scope.namespace_level &&
-				scope_it->scope.level >= _current_scope.level)
-			{
-				scope_it = scope_list.erase(scope_it);
-			}
-			else
-			{
-				++scope_it;
-			}
-		}
+		const auto scope_it = std::find_if(scope_list.rbegin(), scope_list.rend(),
+			[this](const scoped_symbol &item) {
+				return item.scope.level > item.scope.namespace_level && item.scope.level >= _current_scope.level;
+			});
+		assert(scope_it != scope_list.rend());
+		scope_list.erase(std::next(scope_it).base());
+
+		_local_symbols.pop_back();
 	}
 
 	_current_scope.level--;
@@ -245,7 +266,12 @@ bool reshadefx::symbol_table::insert_symbol(const std::string &name, const symbo
 	else
 	{
 		// This is a local symbol so it's sufficient to update the symbol stack with just the current scope
-		insert_sorted(_symbol_stack[name], scoped_symbol { symbol, _current_scope });
+		std::vector<scoped_symbol> &scope_list = _symbol_stack[name];
+		insert_sorted(scope_list, scoped_symbol { symbol, _current_scope });
+
+		// Remember symbols that have to be removed again when leaving the current scope (references to elements of an unordered map are stable, so it is safe to keep a pointer to the list)
+		if (_current_scope.level > _current_scope.namespace_level)
+			_local_symbols.emplace_back(_current_scope.level, &scope_list);
 	}
 
 	return true;
@@ -400,9 +426,13 @@ bool reshadefx::symbol_table::resolve_function_call(const std::string &name, con
 	// Try matching against intrinsic functions if no matching user-defined function was found up to this point
 	if (num_overloads == 0)
 	{
-		for (const intrinsic &intrinsic : s_intrinsics)
+		const auto [overloads_begin, overloads_end] = find_intrinsic_overloads(name);
+
+		for (auto it = overloads_begin; it != overloads_end; ++it)
 		{
-			if (intrinsic.function.name != name || intrinsic.function.parameter_list.size() != arguments.size())
+			const intrinsic &intrinsic = *it;
+
+			if (intrinsic.function.parameter_list.size() != arguments.size())
 				continue;
 
 			// A new possibly-matching intrinsic function was found, compare it against the current result
@@ -99,5 +99,7 @@ namespace reshadefx
 		scope _current_scope;
 		// Lookup table from name to matching symbols
 		std::unordered_map<std::string, std::vector<scoped_symbol>> _symbol_stack;
+		// Scope level and symbol list of every local symbol inserted in the current scope chain, in insertion order
+		std::vector<std::pair<uint32_t, std::vector<scoped_symbol> *>> _local_symbols;
 	};
 }
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2021 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "file_watcher.hpp"
+#include <unordered_map>
+#include <algorithm> // std::find_if
+#include <Windows.h>
+
+// Directories without change notifications are polled at this interval
+static constexpr std::chrono::milliseconds s_poll_interval(1000);
+
+struct file_watcher::watched_directory
+{
+	std::filesystem::path path;
+	HANDLE handle = INVALID_HANDLE_VALUE;
+	OVERLAPPED overlapped = {};
+	// Last modification time of every file in the directory and its subdirectories, only used when the directory is polled
+	std::unordered_map<std::filesystem::path::string_type, std::filesystem::file_time_type> file_times;
+	alignas(DWORD) BYTE buffer[16384];
+};
+
+file_watcher::file_watcher(const std::vector<std::filesystem::path> &paths, std::chrono::milliseconds delay) :
+	_delay(delay)
+{
+	_stop_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+	size_t num_notified_directories = 0;
+
+	for (const std::filesystem::path &path : paths)
+	{
+		// The same directory may be passed in multiple times (e.g. when it is both an effect and texture search path)
+		if (std::find_if(_directories.begin(), _directories.end(),
+			[&path](const std::unique_ptr<watched_directory> &dir) { return dir->path == path; }) != _directories.end())
+			continue;
+
+		auto &dir = *_directories.emplace_back(std::make_unique<watched_directory>());
+		dir.path = path;
+
+		// 'WaitForMultipleObjects' can only wait on a limited number of handles (one of which is used for the stop event), so have to poll any further directories
+		if (num_notified_directories < MAXIMUM_WAIT_OBJECTS - 1)
+			dir.handle = CreateFileW(path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+
+		if (dir.handle != INVALID_HANDLE_VALUE)
+		{
+			dir.overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+			if (dir.overlapped.hEvent != nullptr && read_changes(dir))
+			{
+				num_notified_directories++;
+				continue;
+			}
+
+			if (dir.overlapped.hEvent != nullptr)
+				CloseHandle(dir.overlapped.hEvent);
+			dir.overlapped.hEvent = nullptr;
+			CloseHandle(dir.handle);
+			dir.handle = INVALID_HANDLE_VALUE;
+		}
+
+		// Change notifications are not supported for this directory, so take an initial snapshot of the files in it to compare against when polling
+		poll_changes(dir, nullptr);
+	}
+
+	_thread = std::thread(&file_watcher::watcher_main, this);
+}
+file_watcher::~file_watcher()
+{
+	SetEvent(_stop_event);
+	_thread.join();
+
+	for (const std::unique_ptr<watched_directory> &dir : _directories)
+	{
+		if (dir->handle == INVALID_HANDLE_VALUE)
+			continue;
+
+		// Make sure the pending read operation completed before freeing the buffer it writes to
+		DWORD size = 0;
+		CancelIoEx(dir->handle, &dir->overlapped);
+		GetOverlappedResult(dir->handle, &dir->overlapped, &size, TRUE);
+
+		CloseHandle(dir->overlapped.hEvent);
+		CloseHandle(dir->handle);
+	}
+
+	CloseHandle(_stop_event);
+}
+
+bool file_watcher::check(std::vector<std::filesystem::path> &changed_files)
+{
+	const std::unique_lock<std::mutex> lock(_mutex);
+
+	// Wait for a while after the last change, in case more are about to follow
+	if (_changed_files.empty() || std::chrono::steady_clock::now() - _last_change_time < _delay)
+		return false;
+
+	changed_files = std::move(_changed_files);
+	_changed_files.clear();
+	return true;
+}
+
+bool file_watcher::read_changes(watched_directory &dir)
+{
+	ResetEvent(dir.overlapped.hEvent);
+
+	return ReadDirectoryChangesW(dir.handle, dir.buffer, sizeof(dir.buffer), TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE, nullptr, &dir.overlapped, nullptr) != FALSE;
+}
+void file_watcher::poll_changes(watched_directory &dir, std::vector<std::filesystem::path> *changed_files)
+{
+	std::error_code ec;
+	std::unordered_map<std::filesystem::path::string_type, std::filesystem::file_time_type> file_times;
+
+	for (const std::filesystem::directory_entry &entry : std::filesystem::recursive_directory_iterator(dir.path, std::filesystem::directory_options::skip_permission_denied, ec))
+	{
+		if (entry.is_directory(ec))
+			continue;
+
+		const std::filesystem::file_time_type last_write_time = entry.last_write_time(ec);
+
+		if (changed_files != nullptr)
+			if (const auto it = dir.file_times.find(entry.path().native()); it == dir.file_times.end() || it->second != last_write_time)
+				changed_files->push_back(entry.path());
+
+		file_times.emplace(entry.path().native(), last_write_time);
+	}
+
+	// Any files that are no longer there were removed
+	if (changed_files != nullptr)
+		for (const auto &[path, last_write_time] : dir.file_times)
+			if (file_times.find(path) == file_times.end())
+				changed_files->push_back(path);
+
+	dir.file_times = std::move(file_times);
+}
+
+void file_watcher::watcher_main()
+{
+	std::vector<HANDLE> wait_handles;
+	std::vector<watched_directory *> notified_directories;
+	std::vector<watched_directory *> polled_directories;
+
+	wait_handles.push_back(_stop_event);
+
+	for (const std::unique_ptr<watched_directory> &dir : _directories)
+	{
+		if (dir->handle != INVALID_HANDLE_VALUE)
+		{
+			wait_handles.push_back(dir->overlapped.hEvent);
+			notified_directories.push_back(dir.get());
+		}
+		else
+		{
+			polled_directories.push_back(dir.get());
+		}
+	}
+
+	auto last_poll_time = std::chrono::steady_clock::now();
+
+	while (true)
+	{
+		const DWORD result = WaitForMultipleObjects(static_cast<DWORD>(wait_handles.size()), wait_handles.data(), FALSE, polled_directories.empty() ? INFINITE : static_cast<DWORD>(s_poll_interval.count()));
+		if (result == WAIT_OBJECT_0 || result == WAIT_FAILED)
+			break;
+
+		std::vector<std::filesystem::path> changed_files;
+
+		if (result > WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + wait_handles.size())
+		{
+			watched_directory &dir = *notified_directories[result - WAIT_OBJECT_0 - 1];
+
+			if (DWORD size = 0; GetOverlappedResult(dir.handle, &dir.overlapped, &size, FALSE) && size != 0)
+			{
+				for (const BYTE *data = dir.buffer;;)
+				{
+					const auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(data);
+					changed_files.push_back(dir.path / std::wstring_view(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+
+					if (info->NextEntryOffset == 0)
+						break;
+					data += info->NextEntryOffset;
+				}
+			}
+			else
+			{
+				// Too many changes happened at once to fit into the buffer, so do not know which files changed
+				changed_files.push_back(dir.path);
+			}
+
+			// Queue the next read operation right away, so that no changes are missed while processing this one
+			if (!read_changes(dir))
+			{
+				// Cannot receive any further notifications for this directory, so fall back to polling it
+				wait_handles.erase(wait_handles.begin() + (result - WAIT_OBJECT_0));
+				notified_directories.erase(notified_directories.begin() + (result - WAIT_OBJECT_0 - 1));
+
+				CloseHandle(dir.overlapped.hEvent);
+				dir.overlapped.hEvent = nullptr;
+				CloseHandle(dir.handle);
+				dir.handle = INVALID_HANDLE_VALUE;
+
+				poll_changes(dir, nullptr);
+				polled_directories.push_back(&dir);
+			}
+		}
+
+		if (const auto now = std::chrono::steady_clock::now(); !polled_directories.empty() && now - last_poll_time >= s_poll_interval)
+		{
+			last_poll_time = now;
+
+			for (watched_directory *const dir : polled_directories)
+				poll_changes(*dir, &changed_files);
+		}
+
+		if (changed_files.empty())
+			continue;
+
+		const std::unique_lock<std::mutex> lock(_mutex);
+
+		for (std::filesystem::path &changed_file : changed_files)
+			if (std::find(_changed_files.begin(), _changed_files.end(), changed_file) == _changed_files.end())
+				_changed_files.push_back(std::move(changed_file));
+
+		_last_change_time = std::chrono::steady_clock::now();
+	}
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2021 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <filesystem>
+
+/// <summary>
+/// Watches a set of directories for changes to the files in them on a background thread.
+/// Uses directory change notifications where possible and falls back to periodically polling the modification time of all files for directories that do not support those (e.g. some network shares).
+/// </summary>
+class file_watcher
+{
+public:
+	/// <summary>
+	/// Starts watching the specified directories, including all their subdirectories (since effects may include files from those).
+	/// </summary>
+	/// <param name="paths">The absolute paths to the directories to watch.</param>
+	/// <param name="delay">The time to wait after the last change before reporting changes, so that a burst of writes (e.g. an editor saving a file in multiple steps) is reported only once.</param>
+	explicit file_watcher(const std::vector<std::filesystem::path> &paths, std::chrono::milliseconds delay = std::chrono::milliseconds(250));
+	/// <summary>
+	/// Stops watching and waits for the background thread to exit.
+	/// </summary>
+	~file_watcher();
+
+	/// <summary>
+	/// Retrieves the list of files that were added, modified or removed since the last call.
+	/// </summary>
+	/// <param name="changed_files">Receives the paths to the changed files. This may also contain the path to a watched directory if it is not known which files in it changed.</param>
+	/// <returns><see langword="true"/> if there were any changes and no further ones happened within the delay period, <see langword="false"/> otherwise.</returns>
+	bool check(std::vector<std::filesystem::path> &changed_files);
+
+private:
+	struct watched_directory;
+
+	static bool read_changes(watched_directory &dir);
+	static void poll_changes(watched_directory &dir, std::vector<std::filesystem::path> *changed_files);
+
+	void watcher_main();
+
+	std::chrono::milliseconds _delay;
+	std::vector<std::unique_ptr<watched_directory>> _directories;
+	void *_stop_event = nullptr;
+	std::thread _thread;
+	std::mutex _mutex;
+	std::vector<std::filesystem::path> _changed_files;
+	std::chrono::steady_clock::time_point _last_change_time;
+};
@@ -12,11 +12,13 @@
 #include "effect_parser.hpp"
 #include "effect_codegen.hpp"
 #include "effect_preprocessor.hpp"
+#include "effect_hash.hpp"
 #include "input.hpp"
 #include "input_freepie.hpp"
 #include "com_ptr.hpp"
+#include "thread_pool.hpp"
+#include "file_watcher.hpp"
 #include <set>
-#include <thread>
 #include <algorithm>
 #include <stb_image.h>
 #include <stb_image_dds.h>
@@ -75,6 +77,115 @@ static std::vector<std::filesystem::path> find_files(const std::vector<std::file
 	return files;
 }
 
+static std::filesystem::path::string_type make_dependency_key(const std::filesystem::path &path)
+{
+	// File paths are case-insensitive, so normalize them before using them as a key
+	std::filesystem::path::string_type key = path.lexically_normal().native();
+	std::transform(key.begin(), key.end(), key.begin(), [](wchar_t c) { return static_cast<wchar_t>(towlower(c)); });
+	return key;
+}
+
+static bool hash_effect_dependencies(reshadefx::hasher &hasher, const std::filesystem::path &source_file, const std::vector<std::filesystem::path> &included_files, const std::vector<std::pair<std::filesystem::path, std::filesystem::path>> &include_lookups, const std::vector<std::filesystem::path> &include_paths, const std::vector<std::pair<std::string, std::string>> &definitions)
+{
+	// Macro definitions can only affect the pre-processed output if they are referenced in the source code, so only take into account those whose name appears as an identifier in any of the files (this does not catch names that are only formed via token pasting)
+	// This way changing a definition only affects effects that actually make use of it (and a new ReShade version only affects effects checking '__RESHADE__')
+	std::unordered_map<std::string_view, size_t> definition_lookup;
+	for (size_t i = 0; i < definitions.size(); ++i)
+		definition_lookup.emplace(definitions[i].first, i); // Only the first definition of a name is used by the preprocessor
+	std::vector<bool> referenced_definitions(definitions.size());
+
+	const auto mark_referenced_definitions = [&](const std::string_view text) {
+		const auto is_identifier_char = [](char c) {
+			return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+		};
+
+		for (size_t offset = 0; offset < text.size();)
+		{
+			const char c = text[offset];
+			if (!is_identifier_char(c))
+			{
+				offset++;
+				continue;
+			}
+
+			const size_t begin = offset;
+			while (offset < text.size() && is_identifier_char(text[offset]))
+				offset++;
+
+			// Skip numbers (and their suffixes)
+			if (c >= '0' && c <= '9')
+				continue;
+
+			if (const auto it = definition_lookup.find(text.substr(begin, offset - begin));
+				it != definition_lookup.end())
+				referenced_definitions[it->second] = true;
+		}
+	};
+
+	std::string data;
+	for (size_t file_index = 0; file_index <= included_files.size(); ++file_index)
+	{
+		const std::filesystem::path &path = file_index == 0 ? source_file : included_files[file_index - 1];
+
+		FILE *file = nullptr;
+		if (_wfopen_s(&file, path.c_str(), L"rb") != 0)
+			return false;
+		std::error_code ec;
+		const uintmax_t size = std::filesystem::file_size(path, ec);
+		data.resize(ec ? 0 : static_cast<size_t>(size));
+		data.resize(fread(data.data(), 1, data.size(), file));
+		fclose(file);
+
+		const std::string path_string = path.u8string();
+		hasher.update(static_cast<uint64_t>(path_string.size()));
+		hasher.update(path_string);
+		hasher.update(static_cast<uint64_t>(data.size()));
+		hasher.update(data);
+
+		mark_referenced_definitions(data);
+	}
+
+	// Resolve every file name looked up during pre-processing again the same way the preprocessor does, so that a file added to an earlier location (which would shadow the one that was included before) changes the hash too
+	for (const std::pair<std::filesystem::path, std::filesystem::path> &lookup : include_lookups)
+	{
+		std::error_code ec;
+		std::filesystem::path resolved_path = lookup.first;
+		if (!std::filesystem::exists(resolved_path, ec))
+			for (const std::filesystem::path &include_path : include_paths)
+				if (std::filesystem::exists(resolved_path = include_path / lookup.second, ec))
+					break;
+
+		const std::string lookup_string = lookup.first.u8string() + '|' + (std::filesystem::exists(resolved_path, ec) ? resolved_path.u8string() : std::string()) + ';';
+		hasher.update(lookup_string);
+	}
+
+	// Definitions may reference other definitions in their value (e.g. 'BUFFER_RCP_WIDTH'), so follow those too until no new ones are found
+	for (std::vector<bool> previous_referenced_definitions; previous_referenced_definitions != referenced_definitions;)
+	{
+		previous_referenced_definitions = referenced_definitions;
+
+		for (size_t i = 0; i < definitions.size(); ++i)
+			if (previous_referenced_definitions[i])
+				mark_referenced_definitions(definitions[i].second);
+	}
+
+	for (size_t i = 0; i < definitions.size(); ++i)
+	{
+		if (!referenced_definitions[i])
+			continue;
+
+		hasher.update(definitions[i].first + '=' + definitions[i].second + ';');
+	}
+
+	return true;
+}
+
+static void mark_uniform_data_dirty(reshade::effect &effect, size_t offset, size_t size)
+{
+	effect.uniform_data_dirty_begin = std::min(effect.uniform_data_dirty_begin, offset);
+	effect.uniform_data_dirty_end = std::max(effect.uniform_data_dirty_end, offset + size);
+}
+
 reshade::runtime::runtime(api::device *device, api::command_queue *graphics_queue) :
 	_device(device),
 	_graphics_queue(graphics_queue),
@@ -112,7 +223,6 @@ reshade::runtime::runtime(api::device *device, api::command_queue *graphics_queu
 }
 reshade::runtime::~runtime()
 {
-	assert(_worker_threads.empty());
 	assert(!_is_initialized && _techniques.empty());
 
 	if (_d3d_compiler != nullptr)
@@ -373,6 +483,8 @@ void reshade::runtime::on_reset()
 	// Already performs a wait for idle, so no need to do it again before destroying resources below
 	destroy_effects();
 
+	_file_watcher.reset();
+
 	_width = _height = 0;
 
 	for (api::framebuffer fbo : _backbuffer_fbos)
@@ -562,6 +674,7 @@ void reshade::runtime::load_config()
 	config.get("GENERAL", "NoEffectCache", _no_effect_cache);
 	config.get("GENERAL", "NoReloadOnInit", _no_reload_on_init);
 	config.get("GENERAL", "NoReloadOnInitForNonVR", _no_reload_for_non_vr);
+	config.get("GENERAL", "NoReloadOnFileChange", _no_reload_on_file_change);
 
 	config.get("GENERAL", "EffectSearchPaths", _effect_search_paths);
 	config.get("GENERAL", "PerformanceMode", _performance_mode);
@@ -614,6 +727,7 @@ void reshade::runtime::save_config() const
 	config.set("GENERAL", "NoEffectCache", _no_effect_cache);
 	config.set("GENERAL", "NoReloadOnInit", _no_reload_on_init);
 	config.set("GENERAL", "NoReloadOnInitForNonVR", _no_reload_for_non_vr);
+	config.set("GENERAL", "NoReloadOnFileChange", _no_reload_on_file_change);
 
 	config.set("GENERAL", "EffectSearchPaths", _effect_search_paths);
 	config.set("GENERAL", "PerformanceMode", _performance_mode);
@@ -956,18 +1070,9 @@ void reshade::runtime::disable_technique(technique &tech)
 		_effects[tech.effect_index].rendering--;
 }
 
-bool reshade::runtime::load_effect(const std::filesystem::path &source_file, const ini_file &preset, size_t effect_index, bool preprocess_required)
+bool reshade::runtime::load_effect(const std::filesystem::path &source_file, const ini_file &preset, size_t effect_index, bool preprocess_required, reshadefx::include_snapshot_cache *include_snapshots, effect *staged_effect)
 {
-	// Generate a unique string identifying this effect
-	std::string attributes;
-	attributes += "app=" + g_target_executable_path.stem().u8string() + ';';
-	attributes += "width=" + std::to_string(_width) + ';';
-	attributes += "height=" + std::to_string(_height) + ';';
-	attributes += "color_bit_depth=" + std::to_string(_color_bit_depth) + ';';
-	attributes += "version=" + std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION) + ';';
-	attributes += "performance_mode=" + std::string(_performance_mode ? "1" : "0") + ';';
-	attributes += "vendor=" + std::to_string(_vendor_id) + ';';
-	attributes += "device=" + std::to_string(_device_id) + ';';
+	const std::string effect_name = source_file.filename().u8string();
 
 	std::set<std::filesystem::path> include_paths;
 	if (source_file.is_absolute())
@@ -976,35 +1081,90 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		if (resolve_path(include_path))
 			include_paths.emplace(std::move(include_path));
 
+	// Collect all macro definitions that are passed to the preprocessor
+	std::vector<std::pair<std::string, std::string>> preprocessor_definitions = {
+		{ "__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION) },
+		{ "__RESHADE_PERFORMANCE_MODE__", _performance_mode ? "1" : "0" },
+		{ "__VENDOR__", std::to_string(_vendor_id) },
+		{ "__DEVICE__", std::to_string(_device_id) },
+		{ "__RENDERER__", std::to_string(_renderer_id) },
+		{ "__APPLICATION__", std::to_string( // Truncate hash to 32-bit, since lexer currently only supports 32-bit numbers anyway
+			std::hash<std::string>()(g_target_executable_path.stem().u8string()) & 0xFFFFFFFF) },
+		{ "BUFFER_WIDTH", std::to_string(_width) },
+		{ "BUFFER_HEIGHT", std::to_string(_height) },
+		{ "BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)" },
+		{ "BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)" },
+		{ "BUFFER_COLOR_BIT_DEPTH", std::to_string(_color_bit_depth) },
+	};
+
+	{	std::vector<std::string> definitions = _global_preprocessor_definitions;
+		// Insert preset preprocessor definitions before global ones, so that if there are duplicates, the preset ones are used (since 'add_macro_definition' succeeds only for the first occurance)
+		definitions.insert(definitions.begin(), _preset_preprocessor_definitions.begin(), _preset_preprocessor_definitions.end());
+
+		for (const std::string &definition : definitions)
+		{
+			if (definition.empty() || definition == "=")
+				continue; // Skip invalid definitions
+
+			const size_t equals_index = definition.find('=');
+			if (equals_index != std::string::npos)
+				preprocessor_definitions.emplace_back(definition.substr(0, equals_index), definition.substr(equals_index + 1));
+			else
+				preprocessor_definitions.emplace_back(definition, "1");
+		}
+	}
+
+	// Generate a stable key identifying the inputs that are independent of the effect source code
+	reshadefx::hasher attributes_hasher;
+	attributes_hasher.update(source_file.u8string());
+	attributes_hasher.update(static_cast<uint64_t>(_renderer_id));
 	for (const std::filesystem::path &include_path : include_paths)
+		attributes_hasher.update(include_path.u8string() + ';');
+
+	// The list of files included by an effect is only known after pre-processing, so it is cached separately from the pre-processed source and used to find the latter again
+	const std::string dependency_cache_id = source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + attributes_hasher.finalize().to_string();
+
+	effect &effect = (staged_effect != nullptr) ? *staged_effect : _effects[effect_index];
+
+	bool dependencies_known = false;
+	std::vector<std::filesystem::path> included_files;
+	std::vector<std::pair<std::filesystem::path, std::filesystem::path>> include_lookups;
+	std::vector<std::pair<std::string, std::string>> used_definitions;
+	if (source_file == effect.source_file && effect.preprocessed)
 	{
-		std::error_code ec;
-		attributes += include_path.u8string();
-		for (const auto &entry : std::filesystem::directory_iterator(include_path, std::filesystem::directory_options::skip_permission_denied, ec))
+		dependencies_known = true;
+		included_files = effect.included_files;
+		include_lookups = effect.include_lookups;
+	}
+	else if (std::string dependency_data; load_effect_cache(dependency_cache_id, "dep", dependency_data))
+	{
+		dependencies_known = true;
+
+		for (size_t line_offset = 0, next_line_offset; (next_line_offset = dependency_data.find('\n', line_offset)) != std::string::npos; line_offset = next_line_offset + 1)
 		{
-			const std::filesystem::path filename = entry.path().filename();
-			if (filename == source_file.filename() || filename.extension() == L".fxh")
-			{
-				attributes += ',';
-				attributes += filename.u8string();
-				attributes += '?';
-				attributes += std::to_string(entry.last_write_time(ec).time_since_epoch().count());
-			}
+			const std::string_view line(dependency_data.c_str() + line_offset, next_line_offset - line_offset);
+
+			if (line.compare(0, 8, "include ") == 0)
+				included_files.push_back(std::filesystem::u8path(line.substr(8)));
+			else if (const size_t separator_index = line.find('|'); line.compare(0, 7, "lookup ") == 0 && separator_index != std::string_view::npos)
+				include_lookups.emplace_back(std::filesystem::u8path(line.substr(7, separator_index - 7)), std::filesystem::u8path(line.substr(separator_index + 1)));
+			else if (const size_t equals_index = line.find('='); line.compare(0, 7, "define ") == 0 && equals_index != std::string_view::npos)
+				used_definitions.emplace_back(line.substr(7, equals_index - 7), line.substr(equals_index + 1));
 		}
-		attributes += ';';
 	}
 
-	std::vector<std::string> preprocessor_definitions = _global_preprocessor_definitions;
-	// Insert preset preprocessor definitions before global ones, so that if there are duplicates, the preset ones are used (since 'add_macro_definition' succeeds only for the first occurance)
-	preprocessor_definitions.insert(preprocessor_definitions.begin(), _preset_preprocessor_definitions.begin(), _preset_preprocessor_definitions.end());
-	for (const std::string &definition : preprocessor_definitions)
-		attributes += definition + ';';
-
-	const size_t source_hash = std::hash<std::string>()(attributes);
+	// Hash the contents of the effect file and all the files it includes, so that changes to unrelated files do not cause the effect to be pre-processed again
+	reshadefx::hash128 source_hash;
+	if (dependencies_known)
+	{
+		reshadefx::hasher source_hasher = attributes_hasher;
+		if (hash_effect_dependencies(source_hasher, source_file, included_files, include_lookups, include_paths, preprocessor_definitions))
+			source_hash = source_hasher.finalize();
+		else
+			dependencies_known = false; // One of the included files was removed, so need to pre-process again
+	}
 
-	effect &effect = _effects[effect_index];
-	const std::string effect_name = source_file.filename().u8string();
-	if (source_file != effect.source_file || source_hash != effect.source_hash)
+	if (source_file != effect.source_file || !dependencies_known || source_hash != effect.source_hash)
 	{
 		// Source hash has changed, reset effect and load from scratch, rather than updating
 		effect = {};
@@ -1012,7 +1172,7 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		effect.source_hash = source_hash;
 	}
 
-	if (_effect_load_skipping && !_load_option_disable_skipping && !_worker_threads.empty()) // Only skip during 'load_effects'
+	if (_effect_load_skipping && !_load_option_disable_skipping && is_loading()) // Only skip during 'load_effects'
 	{
 		if (std::vector<std::string> techniques;
 			preset.get({}, "Techniques", techniques))
@@ -1031,39 +1191,30 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 	}
 
 	bool source_cached = false; std::string source;
-	if (!effect.preprocessed && (preprocess_required || (source_cached = load_effect_cache(source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(source_hash), "i", source)) == false))
+	if (!effect.preprocessed && !preprocess_required && dependencies_known && (source_cached = load_effect_cache(source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + source_hash.to_string(), "i", source)) != false)
+	{
+		// Restore the information gathered during pre-processing from the dependency cache, so that the preprocessor does not have to run again just to display it in the overlay
+		effect.preprocessed = true;
+		effect.included_files = std::move(included_files);
+		effect.include_lookups = std::move(include_lookups);
+		effect.definitions = std::move(used_definitions);
+	}
+
+	if (!effect.preprocessed)
 	{
 		reshadefx::preprocessor pp;
-		pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
-		pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", _performance_mode ? "1" : "0");
-		pp.add_macro_definition("__VENDOR__", std::to_string(_vendor_id));
-		pp.add_macro_definition("__DEVICE__", std::to_string(_device_id));
-		pp.add_macro_definition("__RENDERER__", std::to_string(_renderer_id));
-		pp.add_macro_definition("__APPLICATION__", std::to_string( // Truncate hash to 32-bit, since lexer currently only supports 32-bit numbers anyway
-			std::hash<std::string>()(g_target_executable_path.stem().u8string()) & 0xFFFFFFFF));
-		pp.add_macro_definition("BUFFER_WIDTH", std::to_string(_width));
-		pp.add_macro_definition("BUFFER_HEIGHT", std::to_string(_height));
-		pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
-		pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
-		pp.add_macro_definition("BUFFER_COLOR_BIT_DEPTH", std::to_string(_color_bit_depth));
-
-		for (const std::string &definition : preprocessor_definitions)
-		{
-			if (definition.empty() || definition == "=")
-				continue; // Skip invalid definitions
 
-			const size_t equals_index = definition.find('=');
-			if (equals_index != std::string::npos)
-				pp.add_macro_definition(
-					definition.substr(0, equals_index),
-					definition.substr(equals_index + 1));
-			else
-				pp.add_macro_definition(definition);
-		}
+		for (const std::pair<std::string, std::string> &definition : preprocessor_definitions)
+			pp.add_macro_definition(definition.first, definition.second);
 
 		for (const std::filesystem::path &include_path : include_paths)
 			pp.add_include_path(include_path);
 
+		// Share the state after common include files (like 'ReShade.fxh') with the other effects that are loaded at the same time
+		pp.set_include_snapshot_cache(include_snapshots);
+		// Read files included by many effects only once during a reload
+		pp.set_source_file_cache(_source_file_cache.get());
+
 		// Add some conversion macros for compatibility with older versions of ReShade
 		pp.append_string(
 			"#define tex2Doffset(s, coords, offset) tex2D(s, coords, offset)\n"
@@ -1081,10 +1232,14 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		// Append preprocessor errors to the error list
 		effect.errors      += pp.errors();
 
+		// Keep track of included files (even if pre-processing failed, so that fixing the error in one of them causes the effect to be reloaded)
+		effect.included_files = pp.included_files();
+		std::sort(effect.included_files.begin(), effect.included_files.end()); // Sort file names alphabetically
+		effect.include_lookups = pp.include_lookups();
+
 		if (effect.preprocessed)
 		{
 			source = std::move(pp.output());
-			source_cached = save_effect_cache(source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(source_hash), "i", source);
 
 			// Keep track of used preprocessor definitions (so they can be displayed in the overlay)
 			effect.definitions.clear();
@@ -1098,9 +1253,27 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 
 			std::sort(effect.definitions.begin(), effect.definitions.end());
 
-			// Keep track of included files
-			effect.included_files = pp.included_files();
-			std::sort(effect.included_files.begin(), effect.included_files.end()); // Sort file names alphabetically
+			// Now that the actual list of included files is known, calculate the key for the pre-processed source and save it together with the list, so it can be found again next time
+			if (reshadefx::hasher source_hasher = attributes_hasher;
+				hash_effect_dependencies(source_hasher, source_file, effect.included_files, effect.include_lookups, include_paths, preprocessor_definitions))
+			{
+				effect.source_hash = source_hasher.finalize();
+
+				source_cached = save_effect_cache(source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + effect.source_hash.to_string(), "i", source);
+
+				if (source_cached)
+				{
+					std::string dependency_data;
+					for (const std::filesystem::path &included_file : effect.included_files)
+						dependency_data += "include " + included_file.u8string() + '\n';
+					for (const std::pair<std::filesystem::path, std::filesystem::path> &lookup : effect.include_lookups)
+						dependency_data += "lookup " + lookup.first.u8string() + '|' + lookup.second.u8string() + '\n';
+					for (const std::pair<std::string, std::string> &definition : effect.definitions)
+						dependency_data += "define " + definition.first + '=' + definition.second + '\n';
+
+					save_effect_cache(dependency_cache_id, "dep", dependency_data, true);
+				}
+			}
 		}
 	}
 
@@ -1118,28 +1291,66 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		else
 			shader_model = 51; // D3D12
 
-		std::unique_ptr<reshadefx::codegen> codegen;
-		if ((_renderer_id & 0xF0000) == 0)
-			codegen.reset(reshadefx::create_codegen_hlsl(shader_model, !_no_debug_info, _performance_mode));
-		else if (_renderer_id < 0x20000)
-			codegen.reset(reshadefx::create_codegen_glsl(!_no_debug_info, _performance_mode, false, true));
-		else // Vulkan uses SPIR-V input
-			codegen.reset(reshadefx::create_codegen_spirv(true, !_no_debug_info, _performance_mode, false, false));
+		// Code generation only depends on the pre-processed source code and the code generation options, so can skip parsing entirely if the same combination was compiled before
+		std::string module_attributes;
+		module_attributes += "renderer=" + std::to_string(_renderer_id) + ';';
+		module_attributes += "shader_model=" + std::to_string(shader_model) + ';';
+		module_attributes += "debug_info=" + std::string(_no_debug_info ? "0" : "1") + ';';
+		module_attributes += "performance_mode=" + std::string(_performance_mode ? "1" : "0") + ';';
+		module_attributes += "version=" + std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION) + ';';
+
+		reshadefx::hasher module_hasher;
+		module_hasher.update(module_attributes);
+		module_hasher.update(source);
+
+		const std::string module_cache_id = source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + module_hasher.finalize().to_string();
+
+		if (std::string module_data; load_effect_cache(module_cache_id, "fxo", module_data))
+		{
+			// Warnings the parser emitted during the original compilation are stored after the module data
+			if (size_t offset = 0; reshadefx::deserialize_module(effect.module, module_data, offset))
+			{
+				effect.compiled = true;
+				effect.errors += module_data.substr(offset);
+			}
+		}
 
-		reshadefx::parser parser;
+		if (!effect.compiled)
+		{
+			std::unique_ptr<reshadefx::codegen> codegen;
+			if ((_renderer_id & 0xF0000) == 0)
+				codegen.reset(reshadefx::create_codegen_hlsl(shader_model, !_no_debug_info, _performance_mode));
+			else if (_renderer_id < 0x20000)
+				codegen.reset(reshadefx::create_codegen_glsl(!_no_debug_info, _performance_mode, false, true));
+			else // Vulkan uses SPIR-V input
+				codegen.reset(reshadefx::create_codegen_spirv(true, !_no_debug_info, _performance_mode, false, false, _performance_mode));
+
+			reshadefx::parser parser;
 
-		// Compile the pre-processed source code (try the compile even if the preprocessor step failed to get additional error information)
-		effect.compiled = parser.parse(std::move(source), codegen.get());
+			// Compile the pre-processed source code (try the compile even if the preprocessor step failed to get additional error information)
+			effect.compiled = parser.parse(std::move(source), codegen.get());
 
-		// Append parser errors to the error list
-		effect.errors  += parser.errors();
+			// Append parser errors to the error list
+			effect.errors  += parser.errors();
 
-		// Write result to effect module
-		codegen->write_result(effect.module);
+			// Write result to effect module
+			codegen->write_result(effect.module);
+
+			// Only cache successfully compiled modules, so that errors are always reported again
+			if (effect.compiled)
+			{
+				std::string module_data;
+				reshadefx::serialize_module(effect.module, module_data);
+				module_data += parser.errors();
+
+				save_effect_cache(module_cache_id, "fxo", module_data);
+			}
+		}
 
 		if (effect.compiled)
 		{
 			effect.uniforms.clear();
+			effect.special_uniforms.clear();
 
 			// Create space for all variables (aligned to 16 bytes)
 			effect.uniform_data_storage.resize((effect.module.total_uniform_size + 15) & ~15);
@@ -1149,7 +1360,7 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 				variable.effect_index = effect_index;
 
 				// Copy initial data into uniform storage area
-				reset_uniform_value(variable);
+				reset_uniform_value(effect, variable);
 
 				const std::string_view special = variable.annotation_as_string("source");
 				if (special.empty()) /* Ignore if annotation is missing */;
@@ -1184,6 +1395,53 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 				else if (special == "ui_hovered" || special == "overlay_hovered")
 					variable.special = special_uniform::overlay_hovered;
 
+				if (variable.special != special_uniform::none)
+				{
+					special_uniform_update update;
+					update.uniform_index = effect.uniforms.size();
+					update.special = variable.special;
+
+					switch (variable.special)
+					{
+					case special_uniform::random:
+						update.min_int = variable.annotation_as_int("min", 0, 0);
+						update.max_int = variable.annotation_as_int("max", 0, RAND_MAX);
+						break;
+					case special_uniform::ping_pong:
+						update.min = variable.annotation_as_float("min", 0, 0.0f);
+						update.max = variable.annotation_as_float("max", 0, 1.0f);
+						update.step[0] = variable.annotation_as_float("step", 0);
+						update.step[1] = variable.annotation_as_float("step", 1);
+						update.smoothing = variable.annotation_as_float("smoothing");
+						break;
+					case special_uniform::key:
+					case special_uniform::mouse_button:
+						update.index = variable.annotation_as_int("keycode");
+						// Variables with an invalid key code are never updated
+						if (variable.special == special_uniform::key ? (update.index <= 7 || update.index >= 256) : (update.index < 0 || update.index >= 5))
+							update.special = special_uniform::none;
+						else if (const std::string_view mode = variable.annotation_as_string("mode");
+							mode == "toggle" || variable.annotation_as_int("toggle"))
+							update.mode = special_uniform_update::input_mode::toggle;
+						else if (mode == "press")
+							update.mode = special_uniform_update::input_mode::press;
+						break;
+					case special_uniform::mouse_wheel:
+						update.min = variable.annotation_as_float("min");
+						update.max = variable.annotation_as_float("max");
+						update.step[0] = variable.annotation_as_float("step");
+						if (update.step[0] == 0.0f)
+							update.step[0] = 1.0f;
+						break;
+					case special_uniform::freepie:
+						update.index = variable.annotation_as_int("index");
+						break;
+					}
+
+					if (update.special != special_uniform::none)
+						effect.special_uniforms.push_back(update);
+				}
+
 				effect.uniforms.push_back(std::move(variable));
 			}
 
@@ -1240,6 +1498,10 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 				}
 
 				effect.module.hlsl = preamble + effect.module.hlsl;
+
+				for (reshadefx::entry_point &entry_point : effect.module.entry_points)
+					if (!entry_point.hlsl.empty())
+						entry_point.hlsl = preamble + entry_point.hlsl;
 			}
 		}
 	}
@@ -1255,88 +1517,16 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 				effect.compiled = false;
 				break;
 			}
+		}
 
-			auto &assembly = effect.assembly[entry_point.name];
-			std::string &cso = assembly.first;
-			std::string &cso_text = assembly.second;
-
+		const auto compile_entry_point = [this, &effect](const reshadefx::entry_point &entry_point, std::string &cso, std::string &cso_text, std::string &errors) -> bool {
 			if (!effect.module.spirv.empty())
 			{
 				assert(_renderer_id >= 0x14600); // Core since OpenGL 4.6 (see https://www.khronos.org/opengl/wiki/SPIR-V)
 
-				// There are various issues with SPIR-V modules that have multiple entry points on all major GPU vendors.
-				// On AMD for instance creating a graphics pipeline just fails with a generic VK_ERROR_OUT_OF_HOST_MEMORY. On NVIDIA artifacts occur on some driver versions.
-				// To work around these problems, create a separate shader module for every entry point and rewrite the SPIR-V module for each to removes all but a single entry point (and associated functions/variables).
-				uint32_t current_function = 0, current_function_offset = 0;
-				std::vector<uint32_t> spirv = effect.module.spirv;
-				std::vector<uint32_t> functions_to_remove, variables_to_remove;
-
-				for (uint32_t inst = 5 /* Skip SPIR-V header information */; inst < spirv.size();)
-				{
-					const uint32_t op = spirv[inst] & 0xFFFF;
-					const uint32_t len = (spirv[inst] >> 16) & 0xFFFF;
-					assert(len != 0);
-
-					switch (op)
-					{
-					case 15: // OpEntryPoint
-						// Look for any non-matching entry points
-						if (entry_point.name != reinterpret_cast<const char *>(&spirv[inst + 3]))
-						{
-							functions_to_remove.push_back(spirv[inst + 2]);
-
-							// Get interface variables
-							for (uint32_t k = inst + 3 + static_cast<uint32_t>((strlen(reinterpret_cast<const char *>(&spirv[inst + 3])) + 4) / 4); k < inst + len; ++k)
-								variables_to_remove.push_back(spirv[k]);
-
-							// Remove this entry point from the module
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 16: // OpExecutionMode
-						if (std::find(functions_to_remove.begin(), functions_to_remove.end(), spirv[inst + 1]) != functions_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 59: // OpVariable
-						// Remove all declarations of the interface variables for non-matching entry points
-						if (std::find(variables_to_remove.begin(), variables_to_remove.end(), spirv[inst + 2]) != variables_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 71: // OpDecorate
-						// Remove all decorations targeting any of the interface variables for non-matching entry points
-						if (std::find(variables_to_remove.begin(), variables_to_remove.end(), spirv[inst + 1]) != variables_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 54: // OpFunction
-						current_function = spirv[inst + 2];
-						current_function_offset = inst;
-						break;
-					case 56: // OpFunctionEnd
-						// Remove all function definitions for non-matching entry points
-						if (std::find(functions_to_remove.begin(), functions_to_remove.end(), current_function) != functions_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + current_function_offset, spirv.begin() + inst + len);
-							inst = current_function_offset;
-							continue;
-						}
-						break;
-					}
-
-					inst += len;
-				}
-
-				cso.resize(spirv.size() * sizeof(uint32_t));
-				std::memcpy(cso.data(), spirv.data(), cso.size());
+				// Use the module that was generated for just this entry point, since drivers have various issues with modules that contain multiple entry points
+				cso.resize(entry_point.spirv.size() * sizeof(uint32_t));
+				std::memcpy(cso.data(), entry_point.spirv.data(), cso.size());
 			}
 			else if (_renderer_id & 0x10000)
 			{
@@ -1370,7 +1560,8 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 				}
 
 				cso += "#line 1 0\n"; // Reset line number, so it matches what is shown when viewing the generated code
-				cso += effect.module.hlsl;
+				// Prefer the code that was generated for just this entry point, so that the compiler does not have to parse all the others
+				cso += entry_point.hlsl.empty() ? effect.module.hlsl : entry_point.hlsl;
 			}
 			else
 			{
@@ -1383,7 +1574,7 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 					"#define SV_DEPTH_PIXEL_SIZE DEPTH_PIXEL_SIZE\n"
 					"#define SV_TARGET_PIXEL_SIZE COLOR_PIXEL_SIZE\n"
 					"#line 1\n" + // Reset line number, so it matches what is shown when viewing the generated code
-					effect.module.hlsl;
+					(entry_point.hlsl.empty() ? effect.module.hlsl : entry_point.hlsl);
 
 				// Overwrite position semantic in pixel shaders
 				const D3D_SHADER_MACRO ps_defines[] = {
@@ -1440,9 +1631,12 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 				hlsl_attributes += "profile=" + profile + ';';
 				hlsl_attributes += "flags=" + std::to_string(compile_flags) + ';';
 
+				reshadefx::hasher cache_hasher;
+				cache_hasher.update(hlsl_attributes);
+				cache_hasher.update(hlsl);
+
 				const std::string cache_id =
-					effect.source_file.stem().u8string() + '-' + entry_point.name + '-' + std::to_string(_renderer_id) + '-' +
-					std::to_string(std::hash<std::string_view>()(hlsl_attributes) ^ std::hash<std::string_view>()(hlsl));
+					effect.source_file.stem().u8string() + '-' + entry_point.name + '-' + std::to_string(_renderer_id) + '-' + cache_hasher.finalize().to_string();
 
 				if (load_effect_cache(cache_id, "cso", cso) == false)
 				{
@@ -1486,13 +1680,10 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 						}
 					}
 
-					effect.errors += d3d_errors_string;
+					errors += d3d_errors_string;
 
 					if (FAILED(hr))
-					{
-						effect.compiled = false;
-						break;
-					}
+						return false;
 
 					cso.resize(d3d_compiled->GetBufferSize());
 					std::memcpy(cso.data(), d3d_compiled->GetBufferPointer(), cso.size());
@@ -1510,126 +1701,65 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 					save_effect_cache(cache_id, "asm", cso_text);
 				}
 			}
-		}
 
-		const std::unique_lock<std::mutex> lock(_reload_mutex);
+			return true;
+		};
 
-		for (texture new_texture : effect.module.textures)
+		if (effect.compiled)
 		{
-			new_texture.effect_index = effect_index;
+			const size_t num_entry_points = effect.module.entry_points.size();
 
-			// Try to share textures with the same name across effects
-			if (const auto existing_texture = std::find_if(_textures.begin(), _textures.end(),
-				[&new_texture](const auto &item) { return item.unique_name == new_texture.unique_name; });
-				existing_texture != _textures.end())
-			{
-				// Cannot share texture if this is a normal one, but the existing one is a reference and vice versa
-				if (new_texture.semantic != existing_texture->semantic)
-				{
-					effect.errors += "error: " + new_texture.unique_name + ": another effect (";
-					effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
-					effect.errors += ") already created a texture with the same name but different semantic\n";
-					effect.compiled = false;
-					break;
-				}
-
-				if (new_texture.semantic.empty() && !existing_texture->matches_description(new_texture))
-				{
-					effect.errors += "warning: " + new_texture.unique_name + ": another effect (";
-					effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
-					effect.errors += ") already created a texture with the same name but different dimensions\n";
-				}
-				if (new_texture.semantic.empty() && (existing_texture->annotation_as_string("source") != new_texture.annotation_as_string("source")))
-				{
-					effect.errors += "warning: " + new_texture.unique_name + ": another effect (";
-					effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
-					effect.errors += ") already created a texture with a different image file\n";
-				}
+			// Compiler output is collected per entry point and merged in order afterwards, since entry points are compiled in parallel
+			std::vector<std::string> entry_point_errors(num_entry_points);
+			std::vector<uint8_t> entry_point_compiled(num_entry_points);
+			std::vector<std::pair<std::string, std::string> *> entry_point_assembly(num_entry_points);
 
-				if (existing_texture->semantic == "COLOR" && _color_bit_depth != 8)
-				{
-					for (const auto &sampler_info : effect.module.samplers)
-					{
-						if (sampler_info.srgb && sampler_info.texture_name == new_texture.unique_name)
-						{
-							effect.errors += "warning: " + sampler_info.unique_name + ": texture does not support sRGB sampling (back buffer format is not RGBA8)";
-						}
-					}
-				}
+			// Create all assembly entries up front, so that the map is not modified while it is being accessed from multiple threads below
+			for (size_t i = 0; i < num_entry_points; ++i)
+				entry_point_assembly[i] = &effect.assembly[effect.module.entry_points[i].name];
 
-				if (std::find(existing_texture->shared.begin(), existing_texture->shared.end(), effect_index) == existing_texture->shared.end())
-					existing_texture->shared.push_back(effect_index);
+			const auto compile_entry_point_at_index = [&](size_t i) {
+				entry_point_compiled[i] = compile_entry_point(effect.module.entry_points[i], entry_point_assembly[i]->first, entry_point_assembly[i]->second, entry_point_errors[i]);
+			};
 
-				// Always make shared textures render targets, since they may be used as such in a different effect
-				existing_texture->render_target = true;
-				existing_texture->storage_access = true;
-				continue;
+			// Compile each entry point in a separate task, so that effects with many passes do not compile them one after another on a single worker thread
+			if (_worker_pool != nullptr && num_entry_points > 1)
+			{
+				task_group entry_point_tasks(*_worker_pool);
+				for (size_t i = 0; i < num_entry_points; ++i)
+					entry_point_tasks.run([&compile_entry_point_at_index, i]() { compile_entry_point_at_index(i); });
+				// Wait for all entry points to finish compiling before the effect is considered loaded (and passed on to 'create_effect')
+				entry_point_tasks.wait();
 			}
-
-			if (new_texture.annotation_as_int("pooled") && new_texture.semantic.empty())
+			else
 			{
-				// Try to find another pooled texture to share with (and do not share within the same effect)
-				if (const auto existing_texture = std::find_if(_textures.begin(), _textures.end(),
-					[&new_texture](const auto &item) { return item.annotation_as_int("pooled") && item.effect_index != new_texture.effect_index && item.matches_description(new_texture); });
-					existing_texture != _textures.end())
-				{
-					// Overwrite referenced texture in samplers with the pooled one
-					for (auto &sampler_info : effect.module.samplers)
-						if (sampler_info.texture_name == new_texture.unique_name)
-							sampler_info.texture_name  = existing_texture->unique_name;
-					// Overwrite referenced texture in storages with the pooled one
-					for (auto &storage_info : effect.module.storages)
-						if (storage_info.texture_name == new_texture.unique_name)
-							storage_info.texture_name  = existing_texture->unique_name;
-					// Overwrite referenced texture in render targets with the pooled one
-					for (auto &technique_info : effect.module.techniques)
-					{
-						for (auto &pass_info : technique_info.passes)
-						{
-							std::replace(std::begin(pass_info.render_target_names), std::end(pass_info.render_target_names),
-								new_texture.unique_name, existing_texture->unique_name);
-
-							for (auto &sampler_info : pass_info.samplers)
-								if (sampler_info.texture_name == new_texture.unique_name)
-									sampler_info.texture_name  = existing_texture->unique_name;
-							for (auto &storage_info : pass_info.storages)
-								if (storage_info.texture_name == new_texture.unique_name)
-									storage_info.texture_name  = existing_texture->unique_name;
-						}
-					}
-
-					if (std::find(existing_texture->shared.begin(), existing_texture->shared.end(), effect_index) == existing_texture->shared.end())
-						existing_texture->shared.push_back(effect_index);
-
-					existing_texture->render_target = true;
-					existing_texture->storage_access = true;
-					continue;
-				}
+				for (size_t i = 0; i < num_entry_points; ++i)
+					compile_entry_point_at_index(i);
 			}
 
-			if (!new_texture.semantic.empty() && (new_texture.semantic != "COLOR" && new_texture.semantic != "DEPTH"))
-				effect.errors += "warning: " + new_texture.unique_name + ": unknown semantic '" + new_texture.semantic + "'\n";
-
-			// This is the first effect using this texture
-			new_texture.shared.push_back(effect_index);
+			for (size_t i = 0; i < num_entry_points; ++i)
+			{
+				effect.errors += entry_point_errors[i];
 
-			_textures.push_back(std::move(new_texture));
+				if (!entry_point_compiled[i])
+					effect.compiled = false;
+			}
 		}
 
-		for (technique new_technique : effect.module.techniques)
-		{
-			new_technique.effect_index = effect_index;
-
-			new_technique.hidden = new_technique.annotation_as_int("hidden") != 0;
-
-			if (new_technique.annotation_as_int("enabled"))
-				enable_technique(new_technique);
-
-			_techniques.push_back(std::move(new_technique));
-		}
+		// Effects loaded in the background only add their textures and techniques once they replace the previous version (see 'update_effects')
+		if (staged_effect == nullptr)
+			register_effect(effect_index);
+	}
+	else if (staged_effect != nullptr)
+	{
+		// Discard whatever the code generator produced before the failure, so that 'update_effects' does not register partial textures and techniques when swapping this effect in
+		effect.module.textures.clear();
+		effect.module.techniques.clear();
 	}
 
-	if (_reload_remaining_effects != 0 && _reload_remaining_effects != std::numeric_limits<size_t>::max())
+	if (staged_effect != nullptr)
+		_reload_remaining_staged_effects--;
+	else if (_reload_remaining_effects != 0 && _reload_remaining_effects != std::numeric_limits<size_t>::max())
 		_reload_remaining_effects--;
 	else
 		_reload_remaining_effects = 0; // Force effect initialization in 'update_and_render_effects'
@@ -1653,6 +1783,126 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		return false;
 	}
 }
+void reshade::runtime::register_effect(size_t effect_index)
+{
+	effect &effect = _effects[effect_index];
+
+	const std::unique_lock<std::mutex> lock(_reload_mutex);
+
+	for (texture new_texture : effect.module.textures)
+	{
+		new_texture.effect_index = effect_index;
+
+		// Try to share textures with the same name across effects
+		if (const auto existing_texture = std::find_if(_textures.begin(), _textures.end(),
+			[&new_texture](const auto &item) { return item.unique_name == new_texture.unique_name; });
+			existing_texture != _textures.end())
+		{
+			// Cannot share texture if this is a normal one, but the existing one is a reference and vice versa
+			if (new_texture.semantic != existing_texture->semantic)
+			{
+				effect.errors += "error: " + new_texture.unique_name + ": another effect (";
+				effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
+				effect.errors += ") already created a texture with the same name but different semantic\n";
+				effect.compiled = false;
+				break;
+			}
+
+			if (new_texture.semantic.empty() && !existing_texture->matches_description(new_texture))
+			{
+				effect.errors += "warning: " + new_texture.unique_name + ": another effect (";
+				effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
+				effect.errors += ") already created a texture with the same name but different dimensions\n";
+			}
+			if (new_texture.semantic.empty() && (existing_texture->annotation_as_string("source") != new_texture.annotation_as_string("source")))
+			{
+				effect.errors += "warning: " + new_texture.unique_name + ": another effect (";
+				effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
+				effect.errors += ") already created a texture with a different image file\n";
+			}
+
+			if (existing_texture->semantic == "COLOR" && _color_bit_depth != 8)
+			{
+				for (const auto &sampler_info : effect.module.samplers)
+				{
+					if (sampler_info.srgb && sampler_info.texture_name == new_texture.unique_name)
+					{
+						effect.errors += "warning: " + sampler_info.unique_name + ": texture does not support sRGB sampling (back buffer format is not RGBA8)";
+					}
+				}
+			}
+
+			if (std::find(existing_texture->shared.begin(), existing_texture->shared.end(), effect_index) == existing_texture->shared.end())
+				existing_texture->shared.push_back(effect_index);
+
+			// Always make shared textures render targets, since they may be used as such in a different effect
+			existing_texture->render_target = true;
+			existing_texture->storage_access = true;
+			continue;
+		}
+
+		if (new_texture.annotation_as_int("pooled") && new_texture.semantic.empty())
+		{
+			// Try to find another pooled texture to share with (and do not share within the same effect)
+			if (const auto existing_texture = std::find_if(_textures.begin(), _textures.end(),
+				[&new_texture](const auto &item) { return item.annotation_as_int("pooled") && item.effect_index != new_texture.effect_index && item.matches_description(new_texture); });
+				existing_texture != _textures.end())
+			{
+				// Overwrite referenced texture in samplers with the pooled one
+				for (auto &sampler_info : effect.module.samplers)
+					if (sampler_info.texture_name == new_texture.unique_name)
+						sampler_info.texture_name  = existing_texture->unique_name;
+				// Overwrite referenced texture in storages with the pooled one
+				for (auto &storage_info : effect.module.storages)
+					if (storage_info.texture_name == new_texture.unique_name)
+						storage_info.texture_name  = existing_texture->unique_name;
+				// Overwrite referenced texture in render targets with the pooled one
+				for (auto &technique_info : effect.module.techniques)
+				{
+					for (auto &pass_info : technique_info.passes)
+					{
+						std::replace(std::begin(pass_info.render_target_names), std::end(pass_info.render_target_names),
+							new_texture.unique_name, existing_texture->unique_name);
+
+						for (auto &sampler_info : pass_info.samplers)
+							if (sampler_info.texture_name == new_texture.unique_name)
+								sampler_info.texture_name  = existing_texture->unique_name;
+						for (auto &storage_info : pass_info.storages)
+							if (storage_info.texture_name == new_texture.unique_name)
+								storage_info.texture_name  = existing_texture->unique_name;
+					}
+				}
+
+				if (std::find(existing_texture->shared.begin(), existing_texture->shared.end(), effect_index) == existing_texture->shared.end())
+					existing_texture->shared.push_back(effect_index);
+
+				existing_texture->render_target = true;
+				existing_texture->storage_access = true;
+				continue;
+			}
+		}
+
+		if (!new_texture.semantic.empty() && (new_texture.semantic != "COLOR" && new_texture.semantic != "DEPTH"))
+			effect.errors += "warning: " + new_texture.unique_name + ": unknown semantic '" + new_texture.semantic + "'\n";
+
+		// This is the first effect using this texture
+		new_texture.shared.push_back(effect_index);
+
+		_textures.push_back(std::move(new_texture));
+	}
+
+	for (technique new_technique : effect.module.techniques)
+	{
+		new_technique.effect_index = effect_index;
+
+		new_technique.hidden = new_technique.annotation_as_int("hidden") != 0;
+
+		if (new_technique.annotation_as_int("enabled"))
+			enable_technique(new_technique);
+
+		_techniques.push_back(std::move(new_technique));
+	}
+}
 bool reshade::runtime::create_effect(size_t effect_index)
 {
 	effect &effect = _effects[effect_index];
@@ -1791,6 +2041,10 @@ bool reshade::runtime::create_effect(size_t effect_index)
 
 		_device->set_resource_name(effect.cb, "ReShade constant buffer");
 
+		// New buffer has undefined contents, so upload everything before first use (this also discards any range left over from a previous load of the effect, which may have had a larger storage)
+		effect.uniform_data_dirty_begin = 0;
+		effect.uniform_data_dirty_end = effect.uniform_data_storage.size();
+
 		if (!_device->create_descriptor_sets(1, &effect.set_layouts[0], &effect.cb_set))
 		{
 			effect.compiled = false;
@@ -2219,6 +2473,8 @@ bool reshade::runtime::create_effect(size_t effect_index)
 					if (texture.semantic == "COLOR")
 					{
 						srv = _backbuffer_texture_view[info.srgb];
+
+						pass_data.samples_backbuffer = true;
 					}
 					else if (!texture.semantic.empty())
 					{
@@ -2541,6 +2797,22 @@ void reshade::runtime::load_effects()
 	const std::vector<std::filesystem::path> effect_files =
 		find_files(_effect_search_paths, { L".fx" });
 
+	// Watch all search paths for changes, so that effects and textures can be reloaded automatically
+	// This is recreated on every full reload, in case the search paths changed in the meantime
+	_file_watcher.reset();
+	if (!_no_reload_on_file_change)
+	{
+		std::vector<std::filesystem::path> watch_paths;
+		for (std::filesystem::path search_path : _effect_search_paths)
+			if (resolve_path(search_path))
+				watch_paths.push_back(std::move(search_path));
+		for (std::filesystem::path search_path : _texture_search_paths)
+			if (resolve_path(search_path))
+				watch_paths.push_back(std::move(search_path));
+
+		_file_watcher = std::make_unique<file_watcher>(watch_paths);
+	}
+
 	if (effect_files.empty())
 		return; // No effect files found, so nothing more to do
 
@@ -2552,18 +2824,25 @@ void reshade::runtime::load_effects()
 	_effects.resize(offset + effect_files.size());
 	_reload_remaining_effects = effect_files.size();
 
-	// Now that we have a list of files, load them in parallel
-	// Split workload into batches instead of launching a thread for every file to avoid launch overhead and stutters due to too many threads being in flight
-	const size_t num_splits = std::min<size_t>(effect_files.size(), std::max<size_t>(std::thread::hardware_concurrency(), 2u) - 1);
+	// Create worker threads on first use and keep them around for subsequent reloads
+	if (_worker_pool == nullptr)
+		_worker_pool = std::make_unique<thread_pool>();
+	if (_source_file_cache == nullptr)
+		_source_file_cache = std::make_unique<reshadefx::source_file_cache>();
+
+	// Create copy of preset instead of reference, so it stays valid even if 'ini_file::load_cache' is called while effects are still being loaded
+	const auto preset_copy = std::make_shared<const ini_file>(preset);
+
+	// Snapshots of processed include files are only shared between the effects of this reload (so that new files showing up in the include paths are picked up by the next one)
+	const auto include_snapshots = std::make_shared<reshadefx::include_snapshot_cache>();
 
-	// Keep track of the spawned threads, so the runtime cannot be destroyed while they are still running
-	for (size_t n = 0; n < num_splits; ++n)
-		// Create copy of preset instead of reference, so it stays valid even if 'ini_file::load_cache' is called while effects are still being loaded
-		_worker_threads.emplace_back([this, effect_files, offset, num_splits, n, preset]() {
+	// Now that we have a list of files, load them in parallel
+	// Queue a separate task for every file, so that idle worker threads can pick up the remaining files while others are still busy with a heavy one
+	for (size_t i = 0; i < effect_files.size(); ++i)
+		_worker_pool->submit([this, source_file = effect_files[i], preset_copy, include_snapshots, effect_index = offset + i]() {
 			// Abort loading when initialization state changes (indicating that 'on_reset' was called in the meantime)
-			for (size_t i = 0; i < effect_files.size() && _is_initialized; ++i)
-				if (i * num_splits / effect_files.size() == n)
-					load_effect(effect_files[i], preset, offset + i);
+			if (_is_initialized)
+				load_effect(source_file, *preset_copy, effect_index, false, include_snapshots.get());
 		});
 }
 void reshade::runtime::load_textures()
@@ -2630,7 +2909,12 @@ bool reshade::runtime::reload_effect(size_t effect_index, bool preprocess_requir
 
 	const std::filesystem::path source_file = _effects[effect_index].source_file;
 	destroy_effect(effect_index);
-	return load_effect(source_file, ini_file::load_cache(_current_preset_path), effect_index, preprocess_required);
+	const bool success = load_effect(source_file, ini_file::load_cache(_current_preset_path), effect_index, preprocess_required);
+
+	if (_source_file_cache != nullptr)
+		_source_file_cache->clear();
+
+	return success;
 }
 void reshade::runtime::reload_effects()
 {
@@ -2645,13 +2929,79 @@ void reshade::runtime::reload_effects()
 
 	load_effects();
 }
+bool reshade::runtime::reload_effects(const std::vector<std::filesystem::path> &changed_files)
+{
+	// Cannot start another reload while effects are still being loaded, the caller has to try again later
+	if (is_loading() || !_reload_staged_effects.empty())
+		return false;
+
+	// Look up all effects that include any of the changed files (or are one of them)
+	std::vector<size_t> effect_indices;
+	for (const std::filesystem::path &changed_file : changed_files)
+		if (const auto it = _effect_dependents.find(make_dependency_key(changed_file)); it != _effect_dependents.end())
+			effect_indices.insert(effect_indices.end(), it->second.begin(), it->second.end());
+
+	std::sort(effect_indices.begin(), effect_indices.end());
+	effect_indices.erase(std::unique(effect_indices.begin(), effect_indices.end()), effect_indices.end());
+
+	if (effect_indices.empty())
+		return false;
+
+#if RESHADE_GUI
+	_show_splash = false; // Hide splash bar when only reloading some effect files
+#endif
+
+	// Load the new versions of the affected effects in the background, without touching the current ones, so that those keep rendering in the meantime
+	// All others keep their resources and do not have to be created again afterwards
+	_reload_remaining_staged_effects = effect_indices.size();
+	for (const size_t effect_index : effect_indices)
+		_reload_staged_effects.emplace_back(effect_index, std::make_unique<effect>());
+
+	assert(_worker_pool != nullptr);
+
+	const auto preset_copy = std::make_shared<const ini_file>(ini_file::load_cache(_current_preset_path));
+	const auto include_snapshots = std::make_shared<reshadefx::include_snapshot_cache>();
+
+	for (const auto &[effect_index, staged_effect] : _reload_staged_effects)
+		_worker_pool->submit([this, source_file = _effects[effect_index].source_file, preset_copy, include_snapshots, effect_index = effect_index, staged_effect = staged_effect.get()]() {
+			if (_is_initialized)
+				load_effect(source_file, *preset_copy, effect_index, false, include_snapshots.get(), staged_effect);
+			else
+				_reload_remaining_staged_effects--;
+		});
+
+	return true;
+}
+void reshade::runtime::update_effect_dependencies()
+{
+	_effect_dependents.clear();
+
+	for (size_t effect_index = 0; effect_index < _effects.size(); ++effect_index)
+	{
+		const effect &effect = _effects[effect_index];
+		// Skipped effects were never loaded, so there is nothing to update when their files change
+		if (effect.skipped || effect.source_file.empty())
+			continue;
+
+		_effect_dependents[make_dependency_key(effect.source_file)].push_back(effect_index);
+		for (const std::filesystem::path &included_file : effect.included_files)
+			_effect_dependents[make_dependency_key(included_file)].push_back(effect_index);
+	}
+}
 void reshade::runtime::destroy_effects()
 {
 	// Make sure no threads are still accessing effect data
-	for (std::thread &thread : _worker_threads)
-		if (thread.joinable())
-			thread.join();
-	_worker_threads.clear();
+	if (_worker_pool != nullptr)
+		_worker_pool->wait_idle();
+
+	if (_source_file_cache != nullptr)
+		_source_file_cache->clear();
+
+	// Discard any effects that were still waiting to be swapped in
+	_reload_staged_effects.clear();
+	_reload_remaining_staged_effects = 0;
+	// All effects are loaded again from scratch afterwards anyway
+	_reload_pending_files.clear();
 
 	for (size_t effect_index = 0; effect_index < _effects.size(); ++effect_index)
 		destroy_effect(effect_index);
@@ -2663,6 +3013,7 @@ void reshade::runtime::destroy_effects()
 
 	// Reset the effect list after all resources have been destroyed
 	_effects.clear();
+	_effect_dependents.clear();
 
 	// Textures and techniques should have been cleaned up by the calls to 'destroy_effect' above
 	assert(_textures.empty());
@@ -2689,7 +3040,7 @@ bool reshade::runtime::load_effect_cache(const std::string &id, const std::strin
 		return result != FALSE;
 	}
 }
-bool reshade::runtime::save_effect_cache(const std::string &id, const std::string &type, const std::string &source) const
+bool reshade::runtime::save_effect_cache(const std::string &id, const std::string &type, const std::string &source, bool overwrite) const
 {
 	if (_no_effect_cache)
 		return false;
@@ -2697,7 +3048,7 @@ bool reshade::runtime::save_effect_cache(const std::string &id, const std::strin
 	std::filesystem::path path = g_reshade_base_path / _intermediate_cache_path;
 	path /= std::filesystem::u8path("reshade-" + id + '.' + type);
 
-	{	const HANDLE file = CreateFileW(path.c_str(), FILE_GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_NEW, FILE_ATTRIBUTE_ARCHIVE | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	{	const HANDLE file = CreateFileW(path.c_str(), FILE_GENERIC_WRITE, FILE_SHARE_READ, nullptr, overwrite ? CREATE_ALWAYS : CREATE_NEW, FILE_ATTRIBUTE_ARCHIVE | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
 		if (file == INVALID_HANDLE_VALUE)
 			return false;
 		DWORD size = static_cast<DWORD>(source.size());
@@ -2717,7 +3068,7 @@ void reshade::runtime::clear_effect_cache()
 
 		const std::filesystem::path filename = entry.path().filename();
 		const std::filesystem::path extension = entry.path().extension();
-		if (filename.native().compare(0, 8, L"reshade-") != 0 || (extension != L".i" && extension != L".cso" && extension != L".asm"))
+		if (filename.native().compare(0, 8, L"reshade-") != 0 || (extension != L".i" && extension != L".dep" && extension != L".fxo" && extension != L".cso" && extension != L".asm"))
 			continue;
 
 		DeleteFileW(entry.path().c_str());
@@ -2730,13 +3081,62 @@ void reshade::runtime::update_effects()
 	if (_framecount == 0 && !_no_reload_on_init && !(_no_reload_for_non_vr && !_is_vr))
 		reload_effects();
 
+	if (!_reload_staged_effects.empty() && _reload_remaining_staged_effects == 0)
+	{
+		// The last effect was loaded, but wait for its task to return before accessing effect data
+		_worker_pool->wait_idle();
+
+		// The reload is done, so drop the file contents read during it
+		_source_file_cache->clear();
+
+		// Swap in the effects that were loaded in the background (see 'reload_effects')
+		for (const auto &[effect_index, staged_effect] : _reload_staged_effects)
+		{
+			// Recreate the effect right away if the previous version was in use, so that there is not a single frame without it
+			const bool was_rendering = _effects[effect_index].rendering != 0;
+
+			// This waits for the GPU to finish using the resources of the previous version before destroying them
+			destroy_effect(effect_index);
+
+			_effects[effect_index] = std::move(*staged_effect);
+
+			effect &effect = _effects[effect_index];
+			const bool was_compiled = effect.compiled;
+
+			register_effect(effect_index);
+
+			if (was_compiled && !effect.compiled)
+			{
+				_last_reload_successfull = false;
+
+				LOG(ERROR) << "Failed to compile " << effect.source_file << ":\n" << effect.errors;
+			}
+
+			if (was_rendering && effect.compiled && !create_effect(effect_index))
+				_last_reload_successfull = false;
+		}
+
+		_reload_staged_effects.clear();
+
+		// Textures of the new effects still need their image data
+		_textures_loaded = false;
+
+		// Apply preset to the new effects and update editors, like after any other reload
+		_reload_remaining_effects = 0;
+	}
+
 	if (_reload_remaining_effects == 0)
 	{
-		// Clear the thread list now that they all have finished
-		for (std::thread &thread : _worker_threads)
-			if (thread.joinable())
-				thread.join(); // Threads have exited, but still need to join them prior to destruction
-		_worker_threads.clear();
+		// The last effect was loaded, but wait for its task to return before accessing effect data
+		if (_worker_pool != nullptr)
+			_worker_pool->wait_idle();
+
+		// The reload is done, so drop the file contents read during it
+		if (_source_file_cache != nullptr)
+			_source_file_cache->clear();
+
+		// The list of files included by the effects may have changed
+		update_effect_dependencies();
 
 		// Finished loading effects, so apply preset to figure out which ones need compiling
 		load_current_preset();
@@ -2812,6 +3212,96 @@ void reshade::runtime::update_effects()
 		// Now that all effects were compiled, load all textures
 		load_textures();
 	}
+	else if ((_file_watcher != nullptr || !_reload_pending_files.empty()) && _reload_staged_effects.empty())
+	{
+		// Only check for changes once everything is loaded, so that they are not missed by a reload that is still in progress
+		reload_changed_files();
+	}
+}
+void reshade::runtime::reload_changed_files()
+{
+	std::vector<std::filesystem::path> changed_files;
+	if ((_file_watcher == nullptr || !_file_watcher->check(changed_files)) && _reload_pending_files.empty())
+		return;
+
+	std::error_code ec;
+
+	// Skip changes to files that were already reloaded when they were saved (see 'draw_code_editor'), unless they were modified again since
+	for (const auto &[handled_file, handled_time] : _handled_file_changes)
+	{
+		if (std::filesystem::last_write_time(handled_file, ec) != handled_time)
+			continue;
+
+		changed_files.erase(std::remove_if(changed_files.begin(), changed_files.end(),
+			[handled_key = make_dependency_key(handled_file)](const std::filesystem::path &changed_file) { return make_dependency_key(changed_file) == handled_key; }), changed_files.end());
+	}
+	_handled_file_changes.clear();
+
+	// Add files that were saved while another reload was still in progress (see 'draw_code_editor')
+	changed_files.insert(changed_files.end(), _reload_pending_files.begin(), _reload_pending_files.end());
+	_reload_pending_files.clear();
+
+	bool effect_files_changed = false;
+	for (size_t i = 0; i < changed_files.size(); ++i)
+	{
+		if (std::filesystem::is_directory(changed_files[i], ec))
+		{
+			// The watcher lost track of which files changed in this directory, so have to assume all of them did
+			const std::filesystem::path directory = changed_files[i];
+			for (const std::filesystem::directory_entry &entry : std::filesystem::recursive_directory_iterator(directory, std::filesystem::directory_options::skip_permission_denied, ec))
+				if (!entry.is_directory(ec))
+					changed_files.push_back(entry.path());
+
+			effect_files_changed = true;
+		}
+		else if (changed_files[i].extension() == L".fx")
+		{
+			effect_files_changed = true;
+		}
+	}
+
+	// Only reload everything if effect files were actually added or removed, since that changes the list of effects
+	// Otherwise changes to existing effect files (including skipped ones, which are not loaded and therefore do not need to be reloaded) are handled like those to any other file below
+	if (effect_files_changed)
+	{
+		std::vector<std::filesystem::path::string_type> current_effect_files;
+		for (const std::filesystem::path &effect_file : find_files(_effect_search_paths, { L".fx" }))
+			current_effect_files.push_back(make_dependency_key(effect_file));
+		std::vector<std::filesystem::path::string_type> loaded_effect_files;
+		for (const effect &effect : _effects)
+			if (!effect.source_file.empty())
+				loaded_effect_files.push_back(make_dependency_key(effect.source_file));
+
+		std::sort(current_effect_files.begin(), current_effect_files.end());
+		current_effect_files.erase(std::unique(current_effect_files.begin(), current_effect_files.end()), current_effect_files.end());
+		std::sort(loaded_effect_files.begin(), loaded_effect_files.end());
+		loaded_effect_files.erase(std::unique(loaded_effect_files.begin(), loaded_effect_files.end()), loaded_effect_files.end());
+
+		if (current_effect_files != loaded_effect_files)
+		{
+			LOG(INFO) << "Reloading all effects after effect files were added or removed ...";
+			reload_effects();
+			return;
+		}
+	}
+
+	// Check whether any of the image files that are loaded into textures changed
+	for (const texture &tex : _textures)
+	{
+		std::filesystem::path source_path = std::filesystem::u8path(tex.annotation_as_string("source"));
+		if (source_path.empty() || !find_file(_texture_search_paths, source_path))
+			continue;
+
+		if (std::find_if(changed_files.begin(), changed_files.end(),
+			[source_key = make_dependency_key(source_path)](const std::filesystem::path &changed_file) { return make_dependency_key(changed_file) == source_key; }) != changed_files.end())
+		{
+			_textures_loaded = false; // Reload all textures in 'update_effects'
+			break;
+		}
+	}
+
+	// Effects that do not depend on any of the changed files are left untouched
+	reload_effects(changed_files);
 }
 void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource_view rtv, api::resource_view rtv_srgb)
 {
@@ -2833,7 +3323,7 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 	if (!_effects_enabled || _techniques.empty())
 		return;
 
-	// Update special uniform variables
+	// Update uniform variables with shortcut keys and special uniform variables
 	for (effect &effect : _effects)
 	{
 		if (!effect.rendering)
@@ -2871,8 +3361,13 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 				}
 				save_current_preset();
 			}
+		}
 
-			switch (variable.special)
+		for (const special_uniform_update &update : effect.special_uniforms)
+		{
+			uniform &variable = effect.uniforms[update.uniform_index];
+
+			switch (update.special)
 			{
 				case special_uniform::frame_time:
 				{
@@ -2889,19 +3384,17 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 				}
 				case special_uniform::random:
 				{
-					const int min = variable.annotation_as_int("min", 0, 0);
-					const int max = variable.annotation_as_int("max", 0, RAND_MAX);
-					set_uniform_value(variable, min + (std::rand() % (std::abs(max - min) + 1)));
+					set_uniform_value(variable, update.min_int + (std::rand() % (std::abs(update.max_int - update.min_int) + 1)));
 					break;
 				}
 				case special_uniform::ping_pong:
 				{
-					const float min = variable.annotation_as_float("min", 0, 0.0f);
-					const float max = variable.annotation_as_float("max", 0, 1.0f);
-					const float step_min = variable.annotation_as_float("step", 0);
-					const float step_max = variable.annotation_as_float("step", 1);
+					const float min = update.min;
+					const float max = update.max;
+					const float step_min = update.step[0];
+					const float step_max = update.step[1];
 					float increment = step_max == 0 ? step_min : (step_min + std::fmodf(static_cast<float>(std::rand()), step_max - step_min + 1));
-					const float smoothing = variable.annotation_as_float("smoothing");
+					const float smoothing = update.smoothing;
 
 					float value[2] = { 0, 0 };
 					get_uniform_value(variable, value, 2);
@@ -2946,22 +3439,17 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 				}
 				case special_uniform::key:
 				{
-					if (const int keycode = variable.annotation_as_int("keycode");
-						keycode > 7 && keycode < 256)
+					if (update.mode == special_uniform_update::input_mode::toggle)
 					{
-						if (const std::string_view mode = variable.annotation_as_string("mode");
-							mode == "toggle" || variable.annotation_as_int("toggle"))
-						{
-							bool current_value = false;
-							get_uniform_value(variable, &current_value, 1);
-							if (_input->is_key_pressed(keycode))
-								set_uniform_value(variable, !current_value);
-						}
-						else if (mode == "press")
-							set_uniform_value(variable, _input->is_key_pressed(keycode));
-						else
-							set_uniform_value(variable, _input->is_key_down(keycode));
+						bool current_value = false;
+						get_uniform_value(variable, &current_value, 1);
+						if (_input->is_key_pressed(update.index))
+							set_uniform_value(variable, !current_value);
 					}
+					else if (update.mode == special_uniform_update::input_mode::press)
+						set_uniform_value(variable, _input->is_key_pressed(update.index));
+					else
+						set_uniform_value(variable, _input->is_key_down(update.index));
 					break;
 				}
 				case special_uniform::mouse_point:
@@ -2985,40 +3473,29 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 				}
 				case special_uniform::mouse_button:
 				{
-					if (const int keycode = variable.annotation_as_int("keycode");
-						keycode >= 0 && keycode < 5)
+					if (update.mode == special_uniform_update::input_mode::toggle)
 					{
-						if (const std::string_view mode = variable.annotation_as_string("mode");
-							mode == "toggle" || variable.annotation_as_int("toggle"))
-						{
-							bool current_value = false;
-							get_uniform_value(variable, &current_value, 1);
-							if (_input->is_mouse_button_pressed(keycode))
-								set_uniform_value(variable, !current_value);
-						}
-						else if (mode == "press")
-							set_uniform_value(variable, _input->is_mouse_button_pressed(keycode));
-						else
-							set_uniform_value(variable, _input->is_mouse_button_down(keycode));
+						bool current_value = false;
+						get_uniform_value(variable, &current_value, 1);
+						if (_input->is_mouse_button_pressed(update.index))
+							set_uniform_value(variable, !current_value);
 					}
+					else if (update.mode == special_uniform_update::input_mode::press)
+						set_uniform_value(variable, _input->is_mouse_button_pressed(update.index));
+					else
+						set_uniform_value(variable, _input->is_mouse_button_down(update.index));
 					break;
 				}
 				case special_uniform::mouse_wheel:
 				{
-					const float min = variable.annotation_as_float("min");
-					const float max = variable.annotation_as_float("max");
-					float step = variable.annotation_as_float("step");
-					if (step == 0.0f)
-						step  = 1.0f;
-
 					float value[2] = { 0, 0 };
 					get_uniform_value(variable, value, 2);
 					value[1] = _input->mouse_wheel_delta();
-					value[0] = value[0] + value[1] * step;
-					if (min != max)
+					value[0] = value[0] + value[1] * update.step[0];
+					if (update.min != update.max)
 					{
-						value[0] = std::max(value[0], min);
-						value[0] = std::min(value[0], max);
+						value[0] = std::max(value[0], update.min);
+						value[0] = std::min(value[0], update.max);
 					}
 					set_uniform_value(variable, value, 2);
 					break;
@@ -3026,7 +3503,7 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 				case special_uniform::freepie:
 				{
 					if (freepie_io_data data;
-						freepie_io_read(variable.annotation_as_int("index"), &data))
+						freepie_io_read(update.index, &data))
 						set_uniform_value(variable, &data.yaw, 3 * 2);
 					break;
 				}
@@ -3083,6 +3560,9 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 	invoke_addon_event<addon_event::reshade_begin_effects>(this, cmd_list);
 #endif
 
+	// The application rendered to the back buffer since the last time, so the copy of it is outdated
+	_backbuffer_texture_up_to_date = false;
+
 	// Render all enabled techniques
 	for (technique &tech : _techniques)
 	{
@@ -3117,7 +3597,7 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 }
 void reshade::runtime::render_technique(api::command_list *cmd_list, technique &tech, api::resource backbuffer)
 {
-	const effect &effect = _effects[tech.effect_index];
+	effect &effect = _effects[tech.effect_index];
 
 #if RESHADE_GUI
 	if (_gather_gpu_statistics)
@@ -3137,11 +3617,26 @@ void reshade::runtime::render_technique(api::command_list *cmd_list, technique &
 #endif
 
 	// Update shader constants
-	if (api::subresource_data mapped_uniform_data; effect.cb != 0 &&
-		_device->map_resource(effect.cb, 0, api::map_access::write_discard, &mapped_uniform_data))
+	// All techniques of an effect share the same constant buffer, so only need to upload when any value changed since the last time
+	if (effect.cb != 0)
 	{
-		std::memcpy(mapped_uniform_data.data, effect.uniform_data_storage.data(), effect.uniform_data_storage.size());
-		_device->unmap_resource(effect.cb, 0);
+		if (effect.uniform_data_dirty_begin < effect.uniform_data_dirty_end)
+		{
+			// Mapping with discard in D3D10, D3D11 and OpenGL returns new memory that has to be filled entirely, whereas D3D12 and Vulkan map the existing memory, so it is enough to only write the modified range there
+			const bool partial_update = _device->get_api() == api::device_api::d3d12 || _device->get_api() == api::device_api::vulkan;
+			const size_t offset = partial_update ? effect.uniform_data_dirty_begin : 0;
+			const size_t size = partial_update ? effect.uniform_data_dirty_end - offset : effect.uniform_data_storage.size();
+
+			if (api::subresource_data mapped_uniform_data;
+				_device->map_resource(effect.cb, 0, partial_update ? api::map_access::write_only : api::map_access::write_discard, &mapped_uniform_data))
+			{
+				std::memcpy(static_cast<uint8_t *>(mapped_uniform_data.data) + offset, effect.uniform_data_storage.data() + offset, size);
+				_device->unmap_resource(effect.cb, 0);
+
+				effect.uniform_data_dirty_begin = std::numeric_limits<size_t>::max();
+				effect.uniform_data_dirty_end = 0;
+			}
+		}
 	}
 	else if (_renderer_id == 0x9000)
 	{
@@ -3151,13 +3646,17 @@ void reshade::runtime::render_technique(api::command_list *cmd_list, technique &
 	const bool sampler_with_resource_view = _device->check_capability(api::device_caps::sampler_with_resource_view);
 
 	bool is_effect_stencil_cleared = false;
-	bool needs_implicit_backbuffer_copy = true; // First pass always needs the back buffer updated
 
 	for (size_t pass_index = 0; pass_index < tech.passes.size(); ++pass_index)
 	{
-		if (needs_implicit_backbuffer_copy)
+		const reshadefx::pass_info &pass_info = tech.passes[pass_index];
+		const technique::pass_data &pass_data = tech.passes_data[pass_index];
+
+		// Only copy the back buffer if this pass samples it and it was modified since the last copy (by the application or a previous pass rendering to it)
+		if (pass_data.samples_backbuffer && !_backbuffer_texture_up_to_date)
 		{
-			// Save back buffer of previous pass
+			_backbuffer_texture_up_to_date = true;
+
 			const api::resource resources[2] = { backbuffer, _backbuffer_texture };
 			const api::resource_usage state_old[2] = { api::resource_usage::render_target, api::resource_usage::shader_resource };
 			const api::resource_usage state_new[2] = { api::resource_usage::copy_source, api::resource_usage::copy_dest };
@@ -3167,9 +3666,6 @@ void reshade::runtime::render_technique(api::command_list *cmd_list, technique &
 			cmd_list->barrier(2, resources, state_new, state_old);
 		}
 
-		const reshadefx::pass_info &pass_info = tech.passes[pass_index];
-		const technique::pass_data &pass_data = tech.passes_data[pass_index];
-
 #ifndef NDEBUG
 		cmd_list->begin_debug_event((pass_info.name.empty() ? "Pass " + std::to_string(pass_index) : pass_info.name).c_str(), debug_event_col);
 #endif
@@ -3178,9 +3674,6 @@ void reshade::runtime::render_technique(api::command_list *cmd_list, technique &
 
 		if (!pass_info.cs_entry_point.empty())
 		{
-			// Compute shaders do not write to the back buffer, so no update necessary
-			needs_implicit_backbuffer_copy = false;
-
 			cmd_list->bind_pipeline(api::pipeline_stage::all_compute, pass_data.pipeline);
 
 			std::vector<api::resource_usage> state_old(num_barriers, api::resource_usage::shader_resource);
@@ -3214,7 +3707,7 @@ void reshade::runtime::render_technique(api::command_list *cmd_list, technique &
 			// Setup render targets
 			if (pass_info.render_target_names[0].empty())
 			{
-				needs_implicit_backbuffer_copy = true;
+				_backbuffer_texture_up_to_date = false;
 
 				uint32_t index = get_current_back_buffer_index();
 				index = (index * 2) + pass_info.srgb_write_enable;
@@ -3222,8 +3715,6 @@ void reshade::runtime::render_technique(api::command_list *cmd_list, technique &
 			}
 			else
 			{
-				needs_implicit_backbuffer_copy = false;
-
 				cmd_list->begin_render_pass(pass_data.pass, pass_data.fbo);
 			}
 
@@ -3421,36 +3912,6 @@ void reshade::runtime::save_screenshot(const std::wstring &postfix, const bool s
 	}
 }
 
-void reshade::runtime::reset_uniform_value(uniform &variable)
-{
-	if (!variable.has_initializer_value)
-	{
-		std::memset(_effects[variable.effect_index].uniform_data_storage.data() + variable.offset, 0, variable.size);
-		return;
-	}
-
-	// Need to use typed setters, to ensure values are properly forced to floating point in D3D9
-	for (size_t i = 0, array_length = (variable.type.is_array() ? variable.type.array_length : 1);
-		i < array_length; ++i)
-	{
-		const reshadefx::constant &value = variable.type.is_array() ? variable.initializer_value.array_data[i] : variable.initializer_value;
-
-		switch (variable.type.base)
-		{
-		case reshadefx::type::t_int:
-			set_uniform_value(variable, value.as_int, variable.type.components(), i);
-			break;
-		case reshadefx::type::t_bool:
-		case reshadefx::type::t_uint:
-			set_uniform_value(variable, value.as_uint, variable.type.components(), i);
-			break;
-		case reshadefx::type::t_float:
-			set_uniform_value(variable, value.as_float, variable.type.components(), i);
-			break;
-		}
-	}
-}
-
 void reshade::runtime::enumerate_uniform_variables(const char *effect_name, void(*callback)(effect_runtime *runtime, api::effect_uniform_variable variable, void *user_data), void *user_data)
 {
 	if (is_loading())
@@ -3663,11 +4124,15 @@ void reshade::runtime::get_uniform_data(api::effect_uniform_variable handle, uin
 }
 
 void reshade::runtime::set_uniform_data(uniform &variable, const uint8_t *data, size_t size, size_t base_index)
+{
+	set_uniform_data(_effects[variable.effect_index], variable, data, size, base_index);
+}
+void reshade::runtime::set_uniform_data(effect &effect, uniform &variable, const uint8_t *data, size_t size, size_t base_index)
 {
 	size = std::min(size, static_cast<size_t>(variable.size));
 	assert(data != nullptr && (size % 4) == 0);
 
-	auto &data_storage = _effects[variable.effect_index].uniform_data_storage;
+	auto &data_storage = effect.uniform_data_storage;
 	assert(variable.offset + size <= data_storage.size());
 
 	const size_t array_length = (variable.type.is_array() ? variable.type.array_length : 1);
@@ -3695,8 +4160,14 @@ void reshade::runtime::set_uniform_data(uniform &variable, const uint8_t *data,
 	}
 	else
 	{
+		// Many values (e.g. those of special uniforms) are set every frame, but rarely change, so avoid causing an upload when nothing changed
+		if (std::memcmp(data_storage.data() + variable.offset, data, size) == 0)
+			return;
+
 		std::memcpy(data_storage.data() + variable.offset, data, size);
 	}
+
+	mark_uniform_data_dirty(effect, variable.offset, variable.size);
 }
 void reshade::runtime::set_uniform_data(api::effect_uniform_variable handle, const bool *values, size_t count, size_t array_index)
 {
@@ -3779,6 +4250,46 @@ void reshade::runtime::set_uniform_data(api::effect_uniform_variable handle, con
 	}
 }
 
+void reshade::runtime::reset_uniform_value(uniform &variable)
+{
+	reset_uniform_value(_effects[variable.effect_index], variable);
+}
+void reshade::runtime::reset_uniform_value(effect &effect, uniform &variable)
+{
+	if (!variable.has_initializer_value)
+	{
+		std::memset(effect.uniform_data_storage.data() + variable.offset, 0, variable.size);
+		mark_uniform_data_dirty(effect, variable.offset, variable.size);
+		return;
+	}
+
+	// Convert values the same way the typed setters do, to ensure values are properly forced to floating point in D3D9
+	const bool convert_to_floating_point = !variable.type.is_floating_point() && force_floating_point_value(variable.type, _renderer_id);
+	const unsigned int components = variable.type.components();
+
+	for (size_t i = 0, array_length = (variable.type.is_array() ? variable.type.array_length : 1);
+		i < array_length; ++i)
+	{
+		const reshadefx::constant &value = variable.type.is_array() ? variable.initializer_value.array_data[i] : variable.initializer_value;
+
+		uint32_t data[16];
+		for (unsigned int k = 0; k < components; ++k)
+		{
+			if (convert_to_floating_point)
+			{
+				const float converted_value = (variable.type.base == reshadefx::type::t_int) ? static_cast<float>(value.as_int[k]) : static_cast<float>(value.as_uint[k]);
+				std::memcpy(&data[k], &converted_value, sizeof(converted_value));
+			}
+			else
+			{
+				data[k] = value.as_uint[k];
+			}
+		}
+
+		set_uniform_data(effect, variable, reinterpret_cast<const uint8_t *>(data), components * sizeof(uint32_t), i);
+	}
+}
+
 void reshade::runtime::enumerate_texture_variables(const char *effect_name, void(*callback)(effect_runtime *runtime, api::effect_texture_variable variable, void *user_data), void *user_data)
 {
 	if (is_loading())
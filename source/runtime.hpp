@@ -21,6 +21,9 @@ struct ImGuiContext;
 #include <filesystem>
 
 class ini_file;
+class thread_pool;
+class file_watcher;
+namespace reshadefx { class include_snapshot_cache; class source_file_cache; }
 
 namespace reshade
 {
@@ -89,6 +92,7 @@ namespace reshade
 		}
 
 		void set_uniform_data(uniform &variable, const uint8_t *data, size_t size, size_t base_index);
+		void set_uniform_data(effect &effect, uniform &variable, const uint8_t *data, size_t size, size_t base_index);
 		void set_uniform_data(api::effect_uniform_variable variable, const bool *values, size_t count, size_t array_index) final;
 		void set_uniform_data(api::effect_uniform_variable variable, const float *values, size_t count, size_t array_index) final;
 		void set_uniform_data(api::effect_uniform_variable variable, const int32_t *values, size_t count, size_t array_index) final;
@@ -166,7 +170,8 @@ namespace reshade
 		void enable_technique(technique &technique);
 		void disable_technique(technique &technique);
 
-		bool load_effect(const std::filesystem::path &source_file, const ini_file &preset, size_t effect_index, bool preprocess_required = false);
+		bool load_effect(const std::filesystem::path &source_file, const ini_file &preset, size_t effect_index, bool preprocess_required = false, reshadefx::include_snapshot_cache *include_snapshots = nullptr, effect *staged_effect = nullptr);
+		void register_effect(size_t effect_index);
 		bool create_effect(size_t effect_index);
 		void destroy_effect(size_t effect_index);
 
@@ -177,18 +182,22 @@ namespace reshade
 		void load_textures();
 		bool reload_effect(size_t effect_index, bool preprocess_required = false);
 		void reload_effects();
+		bool reload_effects(const std::vector<std::filesystem::path> &changed_files);
+		void update_effect_dependencies();
 		void destroy_effects();
 
 		bool load_effect_cache(const std::string &id, const std::string &type, std::string &data) const;
-		bool save_effect_cache(const std::string &id, const std::string &type, const std::string &source) const;
+		bool save_effect_cache(const std::string &id, const std::string &type, const std::string &source, bool overwrite = false) const;
 		void clear_effect_cache();
 
 		void update_effects();
+		void reload_changed_files();
 		void render_technique(api::command_list *cmd_list, technique &technique, api::resource backbuffer);
 
 		void save_texture(const texture &texture);
 
 		void reset_uniform_value(uniform &variable);
+		void reset_uniform_value(effect &effect, uniform &variable);
 
 		texture &get_texture_internal(const std::string &unique_name);
 
@@ -219,6 +228,7 @@ namespace reshade
 		bool _no_effect_cache = false;
 		bool _no_reload_on_init = false;
 		bool _no_reload_for_non_vr = false;
+		bool _no_reload_on_file_change = false;
 		bool _performance_mode = false;
 		bool _effect_load_skipping = false;
 		bool _load_option_disable_skipping = false;
@@ -229,13 +239,25 @@ namespace reshade
 		unsigned int _performance_mode_key_data[4];
 		std::vector<size_t> _reload_create_queue;
 		std::atomic<size_t> _reload_remaining_effects = 0;
+		// Effects that are reloaded in the background, while the previous version at the same index keeps rendering until they are swapped in
+		std::vector<std::pair<size_t, std::unique_ptr<effect>>> _reload_staged_effects;
+		std::atomic<size_t> _reload_remaining_staged_effects = 0;
+		// Files that were saved while staged effects were still being loaded, which are reloaded once those were swapped in
+		std::vector<std::filesystem::path> _reload_pending_files;
 		std::mutex _reload_mutex;
-		std::vector<std::thread> _worker_threads;
+		std::unique_ptr<thread_pool> _worker_pool;
+		// Contents of the files read during a reload, which is cleared again once the reload is done (so that changes made in the meantime are not missed and memory is not held on to)
+		std::unique_ptr<reshadefx::source_file_cache> _source_file_cache;
+		std::unique_ptr<file_watcher> _file_watcher;
+		// Files that were already reloaded directly after being saved, so that the change reported by the file watcher for them can be skipped
+		std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>> _handled_file_changes;
 		std::vector<std::string> _global_preprocessor_definitions;
 		std::vector<std::string> _preset_preprocessor_definitions;
 		std::vector<std::filesystem::path> _effect_search_paths;
 		std::vector<std::filesystem::path> _texture_search_paths;
 		std::filesystem::path _intermediate_cache_path;
+		// Maps the normalized paths of all effect and include files to the indices of the effects that depend on them
+		std::unordered_map<std::filesystem::path::string_type, std::vector<size_t>> _effect_dependents;
 		std::chrono::high_resolution_clock::time_point _last_reload_time;
 		void *_d3d_compiler = nullptr;
 
@@ -250,6 +272,8 @@ namespace reshade
 		std::vector<api::resource_view> _backbuffer_targets;
 		api::resource _backbuffer_texture = {};
 		api::resource_view _backbuffer_texture_view[2] = {};
+		// Whether the back buffer copy matches the current contents of the back buffer (it is only updated when a pass actually samples it)
+		bool _backbuffer_texture_up_to_date = false;
 		api::format _effect_stencil_format = api::format::unknown;
 		api::resource _effect_stencil = {};
 		api::resource_view _effect_stencil_target = {};
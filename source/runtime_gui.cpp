@@ -1398,6 +1398,16 @@ void reshade::runtime::draw_gui_settings()
 			reload_effects();
 		}
 
+		if (bool reload_on_file_change = !_no_reload_on_file_change;
+			ImGui::Checkbox("Reload effects when files change", &reload_on_file_change))
+		{
+			modified = true;
+			_no_reload_on_file_change = !reload_on_file_change;
+
+			// Start or stop watching the search paths
+			reload_effects();
+		}
+
 		if (ImGui::Button("Clear effect cache", ImVec2(ImGui::CalcItemWidth(), 0)))
 			clear_effect_cache();
 		if (ImGui::IsItemHovered())
@@ -3167,7 +3177,20 @@ void reshade::runtime::draw_code_editor(editor_instance &instance)
 			// Clear modified flag, so that errors are updated next frame (see 'update_and_render_effects')
 			instance.editor.clear_modified();
 
-			reload_effect(instance.effect_index);
+			// The file may be included by other effects as well, so reload all effects that depend on it in the background
+			// Do this right away even if the file watcher is active, since it may not be watching this file (e.g. if it is not in any of the search paths)
+			// If staged effects are still being loaded, they may have read the file before it was saved, so have to reload it again after they were swapped in (see 'reload_changed_files')
+			if (!_reload_staged_effects.empty())
+				_reload_pending_files.push_back(instance.file_path);
+			else if (!reload_effects({ instance.file_path }))
+				reload_effect(instance.effect_index);
+
+			// The file watcher reports this change again later, so remember that it was handled already (see 'reload_changed_files')
+			if (_file_watcher != nullptr)
+			{
+				std::error_code ec;
+				_handled_file_changes.emplace_back(instance.file_path, std::filesystem::last_write_time(instance.file_path, ec));
+			}
 
 			// Reloading an effect file invalidates all textures, but the statistics window may already have drawn references to those, so need to reset it
 			if (ImGuiWindow *const statistics_window = ImGui::FindWindowByName("Statistics");
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "effect_module.hpp"
+#include "effect_hash.hpp"
 
 namespace reshade
 {
@@ -199,12 +200,38 @@ namespace reshade
 			api::descriptor_set storage_set = {};
 			std::vector<api::resource> modified_resources;
 			std::vector<api::resource_view> generate_mipmap_views;
+			bool samples_backbuffer = false;
 		};
 
 		std::vector<pass_data> passes_data;
 		uint32_t query_base_index = 0;
 	};
 
+	/// <summary>
+	/// Parameters of a special uniform variable, resolved from its annotations when the effect is loaded, so that updating it every frame does not need to look them up again.
+	/// </summary>
+	struct special_uniform_update
+	{
+		enum class input_mode
+		{
+			down,
+			press,
+			toggle,
+		};
+
+		size_t uniform_index = 0;
+		special_uniform special = special_uniform::none;
+		input_mode mode = input_mode::down;
+		// Key code, mouse button or FreePIE index
+		int index = 0;
+		int min_int = 0;
+		int max_int = 0;
+		float min = 0.0f;
+		float max = 0.0f;
+		float step[2] = {};
+		float smoothing = 0.0f;
+	};
+
 	struct effect final
 	{
 		unsigned int rendering = 0;
@@ -213,13 +240,18 @@ namespace reshade
 		bool preprocessed = false;
 		std::string errors;
 		reshadefx::module module;
-		size_t source_hash = 0;
+		reshadefx::hash128 source_hash;
 		std::filesystem::path source_file;
 		std::vector<std::filesystem::path> included_files;
+		std::vector<std::pair<std::filesystem::path, std::filesystem::path>> include_lookups;
 		std::vector<std::pair<std::string, std::string>> definitions;
 		std::unordered_map<std::string, std::pair<std::string, std::string>> assembly;
 		std::vector<uniform> uniforms;
+		std::vector<special_uniform_update> special_uniforms;
 		std::vector<unsigned char> uniform_data_storage;
+		// Byte range of the uniform storage that was modified since it was last uploaded to the constant buffer
+		size_t uniform_data_dirty_begin = std::numeric_limits<size_t>::max();
+		size_t uniform_data_dirty_end = 0;
 
 		struct binding_data
 		{
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2021 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "thread_pool.hpp"
+#include <cassert>
+#include <iterator> // std::prev
+#include <algorithm> // std::max, std::find_if
+
+// Identifies the pool and queue the current thread is a worker of, so that tasks submitted from within a task end up in the local queue
+static thread_local const thread_pool *s_current_pool = nullptr;
+static thread_local size_t s_current_queue_index = 0;
+
+thread_pool::thread_pool(size_t num_threads)
+{
+	if (num_threads == 0)
+		num_threads = std::max<size_t>(std::thread::hardware_concurrency(), 2u) - 1;
+
+	_queues.reserve(num_threads);
+	for (size_t i = 0; i < num_threads; ++i)
+		_queues.push_back(std::make_unique<task_queue>());
+
+	// Spawn threads only after all queues were created, since workers may steal from any of them
+	_threads.reserve(num_threads);
+	for (size_t i = 0; i < num_threads; ++i)
+		_threads.emplace_back(&thread_pool::worker_main, this, i);
+}
+thread_pool::~thread_pool()
+{
+	wait_idle();
+
+	{	const std::unique_lock<std::mutex> lock(_mutex);
+		_exit = true;
+	}
+
+	_task_condition.notify_all();
+
+	for (std::thread &thread : _threads)
+		thread.join();
+}
+
+void thread_pool::submit(std::function<void()> task, const task_group *group)
+{
+	assert(task != nullptr);
+
+	// Add tasks submitted from within a worker thread to its own queue, otherwise distribute them evenly across all queues
+	const size_t queue_index = (s_current_pool == this) ? s_current_queue_index : _next_queue_index++ % _queues.size();
+
+	_num_pending_tasks++;
+
+	// Increase queued task count before actually adding the task, so that a worker checking it under the lock does not miss it and go to sleep
+	{	const std::unique_lock<std::mutex> lock(_mutex);
+		_num_queued_tasks++;
+	}
+
+	{	task_queue &queue = *_queues[queue_index];
+		const std::unique_lock<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back({ std::move(task), group });
+	}
+
+	_task_condition.notify_one();
+}
+
+bool thread_pool::run_pending_task(const task_group &group)
+{
+	std::function<void()> task;
+	if (!pop_task(s_current_pool == this ? s_current_queue_index : 0, task, &group))
+		return false;
+
+	execute_task(task);
+	return true;
+}
+
+void thread_pool::wait_idle()
+{
+	assert(s_current_pool != this);
+
+	// Do not help executing tasks here, since the calling thread is usually one that should not be stalled by unrelated long-running work
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle_condition.wait(lock, [this]() { return _num_pending_tasks == 0; });
+}
+
+bool thread_pool::pop_task(size_t queue_index, std::function<void()> &task, const task_group *group)
+{
+	// First look at the own queue (newest task first), then try to steal from the others (oldest task first)
+	for (size_t i = 0; i < _queues.size(); ++i)
+	{
+		task_queue &queue = *_queues[(queue_index + i) % _queues.size()];
+
+		const std::unique_lock<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty())
+			continue;
+
+		// Only consider tasks of the specified group if there is one
+		std::deque<queued_task>::iterator it;
+		if (i == 0)
+		{
+			const auto rit = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(),
+				[group](const queued_task &queued) { return group == nullptr || queued.group == group; });
+			if (rit == queue.tasks.rend())
+				continue;
+			it = std::prev(rit.base());
+		}
+		else
+		{
+			it = std::find_if(queue.tasks.begin(), queue.tasks.end(),
+				[group](const queued_task &queued) { return group == nullptr || queued.group == group; });
+			if (it == queue.tasks.end())
+				continue;
+		}
+
+		task = std::move(it->func);
+		queue.tasks.erase(it);
+
+		_num_queued_tasks--;
+		return true;
+	}
+
+	return false;
+}
+
+void thread_pool::execute_task(std::function<void()> &task)
+{
+	task();
+	task = nullptr; // Destroy any captured state before the task is marked as finished
+
+	if (--_num_pending_tasks == 0)
+	{
+		const std::unique_lock<std::mutex> lock(_mutex);
+		_idle_condition.notify_all();
+	}
+}
+
+void thread_pool::worker_main(size_t queue_index)
+{
+	s_current_pool = this;
+	s_current_queue_index = queue_index;
+
+	std::function<void()> task;
+
+	while (true)
+	{
+		if (pop_task(queue_index, task))
+		{
+			execute_task(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_task_condition.wait(lock, [this]() { return _exit || _num_queued_tasks != 0; });
+
+		if (_exit)
+			break;
+	}
+}
+
+void task_group::run(std::function<void()> task)
+{
+	_num_remaining_tasks++;
+
+	_pool.submit([this, task = std::move(task)]() {
+		task();
+
+		// Decrement under the lock, so that 'wait' cannot return (and the group be destroyed) before this is done accessing it
+		const std::unique_lock<std::mutex> lock(_mutex);
+		if (--_num_remaining_tasks == 0)
+			_condition.notify_all();
+	}, this);
+}
+
+void task_group::wait()
+{
+	while (_num_remaining_tasks != 0)
+	{
+		if (_pool.run_pending_task(*this))
+			continue;
+
+		// None of the tasks in this group are queued anymore, so they must all be executing on other threads at the moment
+		std::unique_lock<std::mutex> lock(_mutex);
+		_condition.wait(lock, [this]() { return _num_remaining_tasks == 0; });
+	}
+
+	// Synchronize with the last finished task, which may still be holding the lock
+	const std::unique_lock<std::mutex> lock(_mutex);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2021 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+class task_group;
+
+/// <summary>
+/// A pool of persistent worker threads executing tasks.
+/// Every worker has its own task queue. Tasks submitted from a worker thread are added to the queue of that worker and processed in LIFO order, while idle workers steal tasks from the other end of the queues of busy ones.
+/// </summary>
+class thread_pool
+{
+public:
+	/// <summary>
+	/// Creates a new thread pool.
+	/// </summary>
+	/// <param name="num_threads">The number of worker threads to spawn, or zero to spawn one less than there are hardware threads (so that the thread submitting work is not starved).</param>
+	explicit thread_pool(size_t num_threads = 0);
+	/// <summary>
+	/// Waits for all pending tasks to finish and then stops all worker threads.
+	/// </summary>
+	~thread_pool();
+
+	size_t num_threads() const { return _threads.size(); }
+
+	/// <summary>
+	/// Queues the specified <paramref name="task"/> for execution on a worker thread.
+	/// </summary>
+	void submit(std::function<void()> task) { submit(std::move(task), nullptr); }
+
+	/// <summary>
+	/// Blocks until all submitted tasks have finished executing.
+	/// This must not be called from within a task running on the same pool, since that task would never finish.
+	/// </summary>
+	void wait_idle();
+
+private:
+	friend class task_group;
+
+	struct queued_task
+	{
+		std::function<void()> func;
+		const task_group *group;
+	};
+	struct task_queue
+	{
+		std::mutex mutex;
+		std::deque<queued_task> tasks;
+	};
+
+	void submit(std::function<void()> task, const task_group *group);
+	bool run_pending_task(const task_group &group);
+
+	bool pop_task(size_t queue_index, std::function<void()> &task, const task_group *group = nullptr);
+	void execute_task(std::function<void()> &task);
+	void worker_main(size_t queue_index);
+
+	std::vector<std::thread> _threads;
+	std::vector<std::unique_ptr<task_queue>> _queues;
+	std::atomic<size_t> _next_queue_index = 0;
+	// Number of tasks that were submitted, but not popped from a queue yet
+	std::atomic<size_t> _num_queued_tasks = 0;
+	// Number of tasks that were submitted, but did not finish executing yet
+	std::atomic<size_t> _num_pending_tasks = 0;
+	std::mutex _mutex;
+	std::condition_variable _task_condition;
+	std::condition_variable _idle_condition;
+	bool _exit = false;
+};
+
+/// <summary>
+/// A set of tasks executed on a <see cref="thread_pool"/> that can be waited on together.
+/// </summary>
+class task_group
+{
+public:
+	explicit task_group(thread_pool &pool) : _pool(pool) {}
+	~task_group() { wait(); }
+
+	/// <summary>
+	/// Queues the specified <paramref name="task"/> for execution as part of this group.
+	/// </summary>
+	void run(std::function<void()> task);
+
+	/// <summary>
+	/// Blocks until all tasks in this group have finished executing.
+	/// The calling thread helps executing queued tasks of this group (and only those) in the meantime, so it is safe to call this from within a task running on the same pool.
+	/// </summary>
+	void wait();
+
+private:
+	thread_pool &_pool;
+	std::atomic<size_t> _num_remaining_tasks = 0;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+};
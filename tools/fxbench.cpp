@@ -0,0 +1,504 @@
+/*
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Benchmark for the effect compiler, measuring the throughput and number of memory allocations of every compilation stage.
+// It only depends on the compiler sources and does not need a GPU, so it can be built on other platforms too, e.g. on Linux with:
+//   g++ -std=c++17 -O2 -I source -I deps/spirv/include/spirv/unified1 tools/fxbench.cpp source/effect_*.cpp -o fxbench -lpthread
+
+#include "effect_lexer.hpp"
+#include "effect_parser.hpp"
+#include "effect_codegen.hpp"
+#include "effect_preprocessor.hpp"
+#include <new>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm> // std::sort
+
+static std::atomic<size_t> s_num_allocations = 0;
+static std::atomic<size_t> s_num_allocated_bytes = 0;
+
+// Count all allocations made through the global allocation functions
+void *operator new(size_t size)
+{
+	s_num_allocations.fetch_add(1, std::memory_order_relaxed);
+	s_num_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+	if (void *const ptr = std::malloc(size != 0 ? size : 1))
+		return ptr;
+	std::abort(); // Release builds are compiled without exception support, so cannot throw here
+}
+void *operator new(size_t size, std::align_val_t alignment)
+{
+	s_num_allocations.fetch_add(1, std::memory_order_relaxed);
+	s_num_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+	// Size passed to 'aligned_alloc' has to be a multiple of the alignment
+	size = (size + static_cast<size_t>(alignment) - 1) & ~(static_cast<size_t>(alignment) - 1);
+#ifdef _WIN32
+	if (void *const ptr = _aligned_malloc(size != 0 ? size : 1, static_cast<size_t>(alignment)))
+#else
+	if (void *const ptr = std::aligned_alloc(static_cast<size_t>(alignment), size != 0 ? size : static_cast<size_t>(alignment)))
+#endif
+		return ptr;
+	std::abort();
+}
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+void operator delete(void *ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+void operator delete(void *ptr, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+static void print_usage(const char *path)
+{
+	printf(R"(usage: %s [options] [<path>...]
+
+Runs every stage of the effect compiler (preprocessor, lexer, parser and each code generator) repeatedly on a set of effects and reports the time per iteration, the throughput and the number of memory allocations.
+Paths may be effect files or directories containing them. If none are specified, the bundled corpus in "tools/fxbench" is used (if it exists in the current directory).
+In addition a set of synthetic effects is generated, which stress deep macro nesting, large numbers of uniforms and long functions.
+
+Options:
+  -h, --help                Print this help.
+
+  -I <path>                 Add directory to include search path.
+  --filter <text>           Only run cases whose name contains the given text.
+  --iterations <count>      Run every stage the given number of times instead of for a minimum amount of time.
+  --min-time <ms>           Run every stage for at least the given amount of milliseconds (default 250).
+  --no-synthetic            Skip the generated synthetic effects.
+  --scale <factor>          Multiply the size of the synthetic effects by the given factor (default 1).
+  --optimize                Run optimization passes over the generated SPIR-V.
+	)", path);
+}
+
+struct bench_options
+{
+	std::vector<std::filesystem::path> include_paths;
+	size_t iterations = 0;
+	double min_time = 250.0;
+	bool optimize = false;
+};
+
+struct bench_case
+{
+	std::string name;
+	// Either the path to an effect file or the source code of a generated one
+	std::filesystem::path path;
+	std::string source;
+};
+
+/// <summary>
+/// Accumulates the time and allocations of the measured part of a stage across iterations.
+/// </summary>
+class stage_timer
+{
+public:
+	void start()
+	{
+		_start_allocations = s_num_allocations;
+		_start_allocated_bytes = s_num_allocated_bytes;
+		_start_time = std::chrono::steady_clock::now();
+	}
+	void stop()
+	{
+		_time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start_time).count();
+		_allocations += s_num_allocations - _start_allocations;
+		_allocated_bytes += s_num_allocated_bytes - _start_allocated_bytes;
+	}
+
+	double time() const { return _time; }
+	size_t allocations() const { return _allocations; }
+	size_t allocated_bytes() const { return _allocated_bytes; }
+
+private:
+	std::chrono::steady_clock::time_point _start_time;
+	size_t _start_allocations = 0, _start_allocated_bytes = 0;
+	double _time = 0.0;
+	size_t _allocations = 0, _allocated_bytes = 0;
+};
+
+template <typename F>
+static void run_stage(const char *case_name, const char *stage_name, size_t input_size, const bench_options &options, F stage)
+{
+	// Run once without measuring to warm up caches (e.g. the file cache of the preprocessor)
+	{
+		stage_timer warmup;
+		if (!stage(warmup))
+		{
+			printf("%-24s %-22s failed\n", case_name, stage_name);
+			return;
+		}
+	}
+
+	stage_timer timer;
+	size_t iterations = 0;
+	do
+	{
+		stage(timer);
+		iterations++;
+	} while (options.iterations != 0 ? iterations < options.iterations : (iterations < 3 || timer.time() < options.min_time));
+
+	const double time = timer.time() / iterations;
+	const double throughput = (input_size / (1024.0 * 1024.0)) / (time / 1000.0);
+
+	printf("%-24s %-22s %10.1f %10.3f %10.1f %10zu %12.1f\n", case_name, stage_name,
+		input_size / 1024.0, time, throughput, timer.allocations() / iterations, (timer.allocated_bytes() / iterations) / 1024.0);
+}
+
+static void setup_preprocessor(reshadefx::preprocessor &pp, const bench_options &options)
+{
+	// Keep file contents around between iterations, so that disk access is not measured
+	static reshadefx::source_file_cache s_source_files;
+	pp.set_source_file_cache(&s_source_files);
+
+	for (const std::filesystem::path &include_path : options.include_paths)
+		pp.add_include_path(include_path);
+
+	// Use fixed values, so that results do not depend on the version or configuration being benchmarked
+	pp.add_macro_definition("__RESHADE__", "50000");
+	pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", "0");
+	pp.add_macro_definition("BUFFER_WIDTH", "1920");
+	pp.add_macro_definition("BUFFER_HEIGHT", "1080");
+	pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+	pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+	pp.add_macro_definition("BUFFER_COLOR_BIT_DEPTH", "8");
+}
+
+static bool preprocess(const bench_case &bench_case, const bench_options &options, std::string &output, std::string &errors)
+{
+	reshadefx::preprocessor pp;
+	setup_preprocessor(pp, options);
+
+	const bool success = bench_case.source.empty() ? pp.append_file(bench_case.path) : pp.append_string(bench_case.source);
+
+	output = std::move(pp.output());
+	errors = std::move(pp.errors());
+	return success;
+}
+
+static void run_case(const bench_case &bench_case, const bench_options &options)
+{
+	std::string source, errors;
+	if (!preprocess(bench_case, options, source, errors))
+	{
+		printf("%-24s failed to preprocess:\n%s", bench_case.name.c_str(), errors.c_str());
+		return;
+	}
+
+	const char *const name = bench_case.name.c_str();
+
+	run_stage(name, "preprocessor", source.size(), options, [&](stage_timer &timer) {
+		std::string output;
+		timer.start();
+		const bool success = preprocess(bench_case, options, output, errors);
+		timer.stop();
+		return success;
+	});
+
+	run_stage(name, "lexer", source.size(), options, [&](stage_timer &timer) {
+		timer.start();
+		reshadefx::lexer lexer(source);
+		while (lexer.lex().id != reshadefx::tokenid::end_of_file)
+			continue;
+		timer.stop();
+		return true;
+	});
+
+	struct backend_desc
+	{
+		const char *parse_stage_name;
+		const char *write_stage_name;
+		reshadefx::codegen *(*create)(const bench_options &options);
+	};
+
+	static const backend_desc backends[] = {
+		{ "parser+codegen_spirv", "codegen_spirv::write", [](const bench_options &options) { return reshadefx::create_codegen_spirv(true, false, false, false, false, options.optimize); } },
+		{ "parser+codegen_glsl", "codegen_glsl::write", [](const bench_options &) { return reshadefx::create_codegen_glsl(false, false); } },
+		{ "parser+codegen_hlsl", "codegen_hlsl::write", [](const bench_options &) { return reshadefx::create_codegen_hlsl(50, false, false); } },
+	};
+
+	for (const backend_desc &backend : backends)
+	{
+		// The parser drives the code generator directly, so emitting code cannot be measured separately from parsing
+		run_stage(name, backend.parse_stage_name, source.size(), options, [&](stage_timer &timer) {
+			const std::unique_ptr<reshadefx::codegen> codegen(backend.create(options));
+			timer.start();
+			reshadefx::parser parser;
+			const bool success = parser.parse(source, codegen.get());
+			timer.stop();
+			return success;
+		});
+
+		run_stage(name, backend.write_stage_name, source.size(), options, [&](stage_timer &timer) {
+			const std::unique_ptr<reshadefx::codegen> codegen(backend.create(options));
+			reshadefx::parser parser;
+			if (!parser.parse(source, codegen.get()))
+				return false;
+			reshadefx::module module;
+			timer.start();
+			codegen->write_result(module);
+			timer.stop();
+			return true;
+		});
+	}
+}
+
+static const char s_synthetic_header[] = R"(
+texture BackBufferTex : COLOR;
+sampler BackBuffer { Texture = BackBufferTex; };
+void PostProcessVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord.x = (id == 2) ? 2.0 : 0.0;
+	texcoord.y = (id == 1) ? 2.0 : 0.0;
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+)";
+static const char s_synthetic_technique[] = R"(
+technique Synthetic { pass { VertexShader = PostProcessVS; PixelShader = PS_Main; } }
+)";
+
+static std::string generate_deep_macros(size_t scale)
+{
+	const size_t depth = 128 * scale;
+	const size_t uses = 64 * scale;
+
+	std::string source = s_synthetic_header;
+
+	// Function-like macros that each expand to the previous one
+	source += "#define M0(x) (x)\n";
+	for (size_t i = 1; i <= depth; ++i)
+		source += "#define M" + std::to_string(i) + "(x) M" + std::to_string(i - 1) + "((x) * 0.5 + " + std::to_string(i % 7) + ".0)\n";
+
+	// Object-like macros that each refer to the previous one
+	source += "#define C0 1\n";
+	for (size_t i = 1; i <= depth; ++i)
+		source += "#define C" + std::to_string(i) + " (C" + std::to_string(i - 1) + " + 1)\n";
+
+	// Nested conditional blocks (the preprocessor expression evaluator has a fixed stack size, so only use the shallower object-like macros in them)
+	for (size_t i = 0; i < depth; ++i)
+		source += "#if defined(M" + std::to_string(i) + ") && C" + std::to_string(i % 32) + " > 0\n";
+	source += "#define NESTED_CONDITIONS_PASSED 1\n";
+	for (size_t i = 0; i < depth; ++i)
+		source += "#endif\n";
+
+	source += "float4 PS_Main(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target\n{\n\tfloat r = NESTED_CONDITIONS_PASSED;\n";
+	for (size_t i = 0; i < uses; ++i)
+		source += "\tr += M" + std::to_string(depth - i % 8) + "(uv.x + r) * C" + std::to_string(i % 16) + ";\n";
+	source += "\treturn float4(r, uv, 1.0);\n}\n";
+	source += s_synthetic_technique;
+
+	return source;
+}
+
+static std::string generate_many_uniforms(size_t scale)
+{
+	const size_t count = 4096 * scale;
+
+	static const char *const types[] = { "float", "float2", "float3", "float4", "int", "bool" };
+	static const char *const values[] = { "0.5", "float2(0.5, 1.0)", "float3(1.0, 0.5, 0.25)", "float4(1.0, 1.0, 1.0, 1.0)", "2", "true" };
+	static const char *const swizzles[] = { ".xxxx", ".xyxy", ".xyzx", "", ".xxxx", ".xxxx" };
+
+	std::string source = s_synthetic_header;
+
+	for (size_t i = 0; i < count; ++i)
+		source += std::string("uniform ") + types[i % 6] + " U" + std::to_string(i) +
+			" < ui_type = \"slider\"; ui_min = 0.0; ui_max = 1.0; ui_label = \"Uniform " + std::to_string(i) + "\"; ui_category = \"Category " + std::to_string(i / 64) + "\"; > = " + values[i % 6] + ";\n";
+
+	source += "float4 PS_Main(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target\n{\n\tfloat4 r = tex2D(BackBuffer, uv);\n";
+	for (size_t i = 0; i < count; ++i)
+		source += "\tr += (float4)U" + std::to_string(i) + swizzles[i % 6] + ";\n";
+	source += "\treturn r;\n}\n";
+	source += s_synthetic_technique;
+
+	return source;
+}
+
+static std::string generate_long_functions(size_t scale)
+{
+	const size_t num_functions = 8 * scale;
+	const size_t num_statements = 1024;
+
+	std::string source = s_synthetic_header;
+
+	for (size_t f = 0; f < num_functions; ++f)
+	{
+		source += "float3 F" + std::to_string(f) + "(float3 a, float2 uv)\n{\n\tfloat3 b = a.zyx;\n";
+		for (size_t i = 0; i < num_statements; ++i)
+		{
+			const std::string n = std::to_string(i);
+
+			switch (i % 8)
+			{
+			case 0:
+				source += "\tfloat3 v" + n + " = a * " + std::to_string(1 + i % 5) + ".0 + b;\n";
+				break;
+			case 1:
+				source += "\ta = lerp(a, b, saturate(dot(a, b)));\n";
+				break;
+			case 2:
+				source += "\tif (a.x > b.y) { b += sin(a) * 0.5; } else { b -= cos(a) * 0.25; }\n";
+				break;
+			case 3:
+				source += "\tfor (int k" + n + " = 0; k" + n + " < 4; ++k" + n + ") a += b * k" + n + ";\n";
+				break;
+			case 4:
+				source += "\tb = tex2Dlod(BackBuffer, float4(uv + a.xy * 0.01, 0, 0)).rgb + b;\n";
+				break;
+			case 5:
+				source += "\ta = max(a, b) - min(a, b) * 0.5;\n";
+				break;
+			case 6:
+				source += "\tb = a.x < 0.5 ? b.zxy : b.yzx;\n";
+				break;
+			case 7:
+				source += "\ta += v" + std::to_string(i - 7) + " * 0.125;\n";
+				break;
+			}
+		}
+		source += "\treturn a + b;\n}\n";
+	}
+
+	source += "float4 PS_Main(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target\n{\n\tfloat3 c = tex2D(BackBuffer, uv).rgb;\n";
+	for (size_t f = 0; f < num_functions; ++f)
+		source += "\tc = F" + std::to_string(f) + "(c, uv);\n";
+	source += "\treturn float4(c, 1.0);\n}\n";
+	source += s_synthetic_technique;
+
+	return source;
+}
+
+static bool add_corpus_path(const std::filesystem::path &path, std::vector<bench_case> &cases)
+{
+	std::error_code ec;
+
+	std::vector<std::filesystem::path> effect_files;
+
+	if (std::filesystem::is_directory(path, ec))
+	{
+		for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(path, std::filesystem::directory_options::skip_permission_denied, ec))
+			if (entry.path().extension() == ".fx")
+				effect_files.push_back(entry.path());
+
+		// Directory iteration order is unspecified, so sort to make the output reproducible
+		std::sort(effect_files.begin(), effect_files.end());
+	}
+	else if (std::filesystem::exists(path, ec))
+	{
+		effect_files.push_back(path);
+	}
+	else
+	{
+		return false;
+	}
+
+	for (const std::filesystem::path &effect_file : effect_files)
+		cases.push_back({ effect_file.filename().u8string(), effect_file, std::string() });
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	bench_options options;
+	std::vector<std::filesystem::path> paths;
+	const char *filter = nullptr;
+	bool synthetic = true;
+	size_t scale = 1;
+
+	// Parse command-line arguments
+	for (int i = 1; i < argc; ++i)
+	{
+		if (const char *arg = argv[i]; arg[0] == '-')
+		{
+			if (0 == std::strcmp(arg, "-h") || 0 == std::strcmp(arg, "--help"))
+			{
+				print_usage(argv[0]);
+				return 0;
+			}
+
+			if (0 == std::strcmp(arg, "--no-synthetic"))
+				synthetic = false;
+			else if (0 == std::strcmp(arg, "--optimize"))
+				options.optimize = true;
+
+			if (i + 1 >= argc)
+				continue;
+			else if (0 == std::strcmp(arg, "-I"))
+				options.include_paths.push_back(argv[++i]);
+			else if (0 == std::strcmp(arg, "--filter"))
+				filter = argv[++i];
+			else if (0 == std::strcmp(arg, "--iterations"))
+				options.iterations = std::strtoul(argv[++i], nullptr, 10);
+			else if (0 == std::strcmp(arg, "--min-time"))
+				options.min_time = std::strtod(argv[++i], nullptr);
+			else if (0 == std::strcmp(arg, "--scale"))
+				scale = std::max<size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+		}
+		else
+		{
+			paths.push_back(arg);
+		}
+	}
+
+	std::vector<bench_case> cases;
+
+	if (paths.empty())
+	{
+		add_corpus_path("tools/fxbench", cases);
+	}
+	else
+	{
+		for (const std::filesystem::path &path : paths)
+		{
+			if (!add_corpus_path(path, cases))
+			{
+				std::cout << "error: Could not find '" << path.u8string() << '\'' << std::endl;
+				return 1;
+			}
+		}
+	}
+
+	if (synthetic)
+	{
+		cases.push_back({ "synthetic_deep_macros", std::filesystem::path(), generate_deep_macros(scale) });
+		cases.push_back({ "synthetic_many_uniforms", std::filesystem::path(), generate_many_uniforms(scale) });
+		cases.push_back({ "synthetic_long_functions", std::filesystem::path(), generate_long_functions(scale) });
+	}
+
+	if (cases.empty())
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	printf("%-24s %-22s %10s %10s %10s %10s %12s\n", "Case", "Stage", "Input KiB", "Time ms", "MiB/s", "Allocs", "Alloc KiB");
+
+	for (const bench_case &bench_case : cases)
+	{
+		if (filter != nullptr && bench_case.name.find(filter) == std::string::npos)
+			continue;
+
+		run_case(bench_case, options);
+	}
+
+	return 0;
+}
@@ -0,0 +1,139 @@
+// Multi-pass bloom with a downsample and upsample chain, representative of effects with many render targets and passes
+
+#include "ReShade.fxh"
+
+#ifndef BLOOM_QUALITY
+	#define BLOOM_QUALITY 2
+#endif
+
+uniform float BloomThreshold < ui_type = "slider"; ui_min = 0.0; ui_max = 4.0; ui_label = "Threshold"; > = 0.8;
+uniform float BloomIntensity < ui_type = "slider"; ui_min = 0.0; ui_max = 2.0; ui_label = "Intensity"; > = 0.5;
+uniform float BloomSaturation < ui_type = "slider"; ui_min = 0.0; ui_max = 2.0; ui_label = "Saturation"; > = 1.0;
+uniform float3 BloomTint < ui_type = "color"; ui_label = "Tint"; > = float3(1.0, 0.95, 0.9);
+uniform int BloomBlendMode < ui_type = "combo"; ui_items = "Additive\0Screen\0Soft Light\0"; > = 1;
+
+#define DECLARE_LEVEL(n, div) \
+	texture BloomTex##n { Width = BUFFER_WIDTH / div; Height = BUFFER_HEIGHT / div; Format = RGBA16F; }; \
+	sampler BloomSampler##n { Texture = BloomTex##n; AddressU = CLAMP; AddressV = CLAMP; };
+
+DECLARE_LEVEL(0, 2)
+DECLARE_LEVEL(1, 4)
+DECLARE_LEVEL(2, 8)
+DECLARE_LEVEL(3, 16)
+DECLARE_LEVEL(4, 32)
+DECLARE_LEVEL(5, 64)
+
+float luminance(float3 color)
+{
+	return dot(color, float3(0.2126, 0.7152, 0.0722));
+}
+
+float3 prefilter(float3 color)
+{
+	const float knee = BloomThreshold * 0.5;
+	float brightness = max(color.r, max(color.g, color.b));
+	float soft = clamp(brightness - BloomThreshold + knee, 0.0, 2.0 * knee);
+	soft = soft * soft / (4.0 * knee + 1e-4);
+	float contribution = max(soft, brightness - BloomThreshold) / max(brightness, 1e-4);
+	return color * contribution;
+}
+
+float3 downsample(sampler s, float2 uv, float2 texel)
+{
+	// 13-tap filter to avoid aliasing when reducing the resolution
+	float3 a = tex2D(s, uv + texel * float2(-2, -2)).rgb;
+	float3 b = tex2D(s, uv + texel * float2( 0, -2)).rgb;
+	float3 c = tex2D(s, uv + texel * float2( 2, -2)).rgb;
+	float3 d = tex2D(s, uv + texel * float2(-1, -1)).rgb;
+	float3 e = tex2D(s, uv + texel * float2( 1, -1)).rgb;
+	float3 f = tex2D(s, uv + texel * float2(-2,  0)).rgb;
+	float3 g = tex2D(s, uv).rgb;
+	float3 h = tex2D(s, uv + texel * float2( 2,  0)).rgb;
+	float3 i = tex2D(s, uv + texel * float2(-1,  1)).rgb;
+	float3 j = tex2D(s, uv + texel * float2( 1,  1)).rgb;
+	float3 k = tex2D(s, uv + texel * float2(-2,  2)).rgb;
+	float3 l = tex2D(s, uv + texel * float2( 0,  2)).rgb;
+	float3 m = tex2D(s, uv + texel * float2( 2,  2)).rgb;
+
+	float3 result = (d + e + i + j) * 0.125;
+	result += (a + b + g + f) * 0.03125;
+	result += (b + c + h + g) * 0.03125;
+	result += (f + g + l + k) * 0.03125;
+	result += (g + h + m + l) * 0.03125;
+	return result;
+}
+
+float3 upsample(sampler s, float2 uv, float2 texel)
+{
+	float3 result = 0;
+	[unroll] for (int y = -1; y <= 1; ++y)
+		[unroll] for (int x = -1; x <= 1; ++x)
+			result += tex2D(s, uv + texel * float2(x, y)).rgb * ((x == 0 ? 2 : 1) * (y == 0 ? 2 : 1));
+	return result / 16.0;
+}
+
+float4 PS_Prefilter(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target
+{
+	float3 color = downsample(ReShade::BackBuffer, uv, BUFFER_PIXEL_SIZE);
+	return float4(prefilter(color), 1.0);
+}
+
+#define DOWNSAMPLE_PASS(src, div) \
+	float4 PS_Downsample##src(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target \
+	{ \
+		return float4(downsample(BloomSampler##src, uv, BUFFER_PIXEL_SIZE * div), 1.0); \
+	}
+#define UPSAMPLE_PASS(src, div) \
+	float4 PS_Upsample##src(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target \
+	{ \
+		return float4(upsample(BloomSampler##src, uv, BUFFER_PIXEL_SIZE * div), 1.0); \
+	}
+
+DOWNSAMPLE_PASS(0, 2)
+DOWNSAMPLE_PASS(1, 4)
+DOWNSAMPLE_PASS(2, 8)
+DOWNSAMPLE_PASS(3, 16)
+DOWNSAMPLE_PASS(4, 32)
+UPSAMPLE_PASS(5, 64)
+UPSAMPLE_PASS(4, 32)
+UPSAMPLE_PASS(3, 16)
+UPSAMPLE_PASS(2, 8)
+UPSAMPLE_PASS(1, 4)
+
+float4 PS_Combine(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target
+{
+	float3 color = tex2D(ReShade::BackBuffer, uv).rgb;
+	float3 bloom = upsample(BloomSampler0, uv, BUFFER_PIXEL_SIZE * 2) * BloomTint;
+	bloom = lerp(luminance(bloom).xxx, bloom, BloomSaturation) * BloomIntensity;
+
+	switch (BloomBlendMode)
+	{
+	case 0:
+		color += bloom;
+		break;
+	case 1:
+		color = 1.0 - (1.0 - saturate(color)) * (1.0 - saturate(bloom));
+		break;
+	default:
+		color = lerp(color - (1.0 - 2.0 * bloom) * color * (1.0 - color), color + (2.0 * bloom - 1.0) * (sqrt(color) - color), step(0.5, bloom));
+		break;
+	}
+
+	return float4(color, 1.0);
+}
+
+technique Bloom < ui_tooltip = "Adds a glow around bright areas of the image."; >
+{
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Prefilter; RenderTarget = BloomTex0; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Downsample0; RenderTarget = BloomTex1; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Downsample1; RenderTarget = BloomTex2; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Downsample2; RenderTarget = BloomTex3; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Downsample3; RenderTarget = BloomTex4; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Downsample4; RenderTarget = BloomTex5; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Upsample5; RenderTarget = BloomTex4; BlendEnable = true; SrcBlend = ONE; DestBlend = ONE; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Upsample4; RenderTarget = BloomTex3; BlendEnable = true; SrcBlend = ONE; DestBlend = ONE; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Upsample3; RenderTarget = BloomTex2; BlendEnable = true; SrcBlend = ONE; DestBlend = ONE; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Upsample2; RenderTarget = BloomTex1; BlendEnable = true; SrcBlend = ONE; DestBlend = ONE; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Upsample1; RenderTarget = BloomTex0; BlendEnable = true; SrcBlend = ONE; DestBlend = ONE; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_Combine; }
+}
@@ -0,0 +1,164 @@
+// Single-pass color grading with many user-facing uniforms and math-heavy helper functions
+
+#include "ReShade.fxh"
+
+uniform float Exposure < ui_type = "slider"; ui_min = -4.0; ui_max = 4.0; ui_category = "Tone Mapping"; > = 0.0;
+uniform int ToneMapper < ui_type = "combo"; ui_items = "None\0Reinhard\0Filmic\0ACES\0Uncharted 2\0"; ui_category = "Tone Mapping"; > = 3;
+uniform float WhitePoint < ui_type = "slider"; ui_min = 1.0; ui_max = 16.0; ui_category = "Tone Mapping"; > = 4.0;
+uniform float Contrast < ui_type = "slider"; ui_min = 0.0; ui_max = 2.0; ui_category = "Basic"; > = 1.0;
+uniform float Saturation < ui_type = "slider"; ui_min = 0.0; ui_max = 2.0; ui_category = "Basic"; > = 1.0;
+uniform float Vibrance < ui_type = "slider"; ui_min = -1.0; ui_max = 1.0; ui_category = "Basic"; > = 0.0;
+uniform float Temperature < ui_type = "slider"; ui_min = -1.0; ui_max = 1.0; ui_category = "White Balance"; > = 0.0;
+uniform float Tint < ui_type = "slider"; ui_min = -1.0; ui_max = 1.0; ui_category = "White Balance"; > = 0.0;
+uniform float3 Lift < ui_type = "color"; ui_category = "Lift Gamma Gain"; > = float3(0.0, 0.0, 0.0);
+uniform float3 Gamma < ui_type = "color"; ui_category = "Lift Gamma Gain"; > = float3(1.0, 1.0, 1.0);
+uniform float3 Gain < ui_type = "color"; ui_category = "Lift Gamma Gain"; > = float3(1.0, 1.0, 1.0);
+uniform float3 ShadowColor < ui_type = "color"; ui_category = "Split Toning"; > = float3(0.5, 0.5, 0.5);
+uniform float3 HighlightColor < ui_type = "color"; ui_category = "Split Toning"; > = float3(0.5, 0.5, 0.5);
+uniform float SplitBalance < ui_type = "slider"; ui_min = -1.0; ui_max = 1.0; ui_category = "Split Toning"; > = 0.0;
+uniform float VignetteAmount < ui_type = "slider"; ui_min = 0.0; ui_max = 1.0; ui_category = "Vignette"; > = 0.25;
+uniform float VignetteRadius < ui_type = "slider"; ui_min = 0.0; ui_max = 2.0; ui_category = "Vignette"; > = 1.0;
+uniform float FilmGrain < ui_type = "slider"; ui_min = 0.0; ui_max = 1.0; ui_category = "Film Grain"; > = 0.05;
+uniform bool EnableDither < ui_category = "Output"; > = true;
+
+uniform float Timer < source = "timer"; >;
+uniform int FrameCount < source = "framecount"; >;
+
+static const float3x3 AcesInputMatrix = float3x3(
+	0.59719, 0.35458, 0.04823,
+	0.07600, 0.90834, 0.01566,
+	0.02840, 0.13383, 0.83777);
+static const float3x3 AcesOutputMatrix = float3x3(
+	 1.60475, -0.53108, -0.07367,
+	-0.10208,  1.10813, -0.00605,
+	-0.00327, -0.07276,  1.07602);
+
+float luminance(float3 color)
+{
+	return dot(color, float3(0.2126, 0.7152, 0.0722));
+}
+
+float3 rgb_to_hsv(float3 c)
+{
+	float4 K = float4(0.0, -1.0 / 3.0, 2.0 / 3.0, -1.0);
+	float4 p = c.g < c.b ? float4(c.bg, K.wz) : float4(c.gb, K.xy);
+	float4 q = c.r < p.x ? float4(p.xyw, c.r) : float4(c.r, p.yzx);
+	float d = q.x - min(q.w, q.y);
+	float e = 1.0e-10;
+	return float3(abs(q.z + (q.w - q.y) / (6.0 * d + e)), d / (q.x + e), q.x);
+}
+float3 hsv_to_rgb(float3 c)
+{
+	float4 K = float4(1.0, 2.0 / 3.0, 1.0 / 3.0, 3.0);
+	float3 p = abs(frac(c.xxx + K.xyz) * 6.0 - K.www);
+	return c.z * lerp(K.xxx, saturate(p - K.xxx), c.y);
+}
+
+float3 rrt_and_odt_fit(float3 v)
+{
+	float3 a = v * (v + 0.0245786) - 0.000090537;
+	float3 b = v * (0.983729 * v + 0.4329510) + 0.238081;
+	return a / b;
+}
+float3 uncharted2_partial(float3 x)
+{
+	const float A = 0.15, B = 0.50, C = 0.10, D = 0.20, E = 0.02, F = 0.30;
+	return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+}
+
+float3 tonemap(float3 color)
+{
+	switch (ToneMapper)
+	{
+	case 1:
+		return color * (1.0 + color / (WhitePoint * WhitePoint)) / (1.0 + color);
+	case 2:
+		color = max(0, color - 0.004);
+		return (color * (6.2 * color + 0.5)) / (color * (6.2 * color + 1.7) + 0.06);
+	case 3:
+		color = mul(AcesInputMatrix, color);
+		color = rrt_and_odt_fit(color);
+		return saturate(mul(AcesOutputMatrix, color));
+	case 4:
+		return uncharted2_partial(color * 2.0) / uncharted2_partial(WhitePoint.xxx);
+	default:
+		return saturate(color);
+	}
+}
+
+float3 white_balance(float3 color)
+{
+	// Approximate shift along the blue-yellow and green-magenta axes
+	float3x3 m = float3x3(
+		1.0 + 0.1 * Temperature, 0.0, 0.0,
+		0.0, 1.0 + 0.05 * Tint, 0.0,
+		0.0, 0.0, 1.0 - 0.1 * Temperature);
+	return mul(m, color);
+}
+
+float3 lift_gamma_gain(float3 color)
+{
+	color = color * (1.5 - 0.5 * Lift) + (0.5 * Lift - 0.5);
+	color = saturate(color) * Gain;
+	return pow(abs(color), 1.0 / max(Gamma, 0.01));
+}
+
+float3 split_tone(float3 color)
+{
+	float l = saturate(luminance(color) + SplitBalance * 0.5);
+	float3 shadows = lerp(0.5, ShadowColor, 1.0 - l);
+	float3 highlights = lerp(0.5, HighlightColor, l);
+	color = lerp(2.0 * color * shadows, 1.0 - 2.0 * (1.0 - color) * (1.0 - shadows), step(0.5, color));
+	color = lerp(2.0 * color * highlights, 1.0 - 2.0 * (1.0 - color) * (1.0 - highlights), step(0.5, color));
+	return color;
+}
+
+float random(float2 uv, float seed)
+{
+	return frac(sin(dot(uv + seed, float2(12.9898, 78.233))) * 43758.5453);
+}
+
+float4 PS_ColorGrading(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target
+{
+	float3 color = tex2D(ReShade::BackBuffer, uv).rgb;
+
+	color *= exp2(Exposure);
+	color = white_balance(color);
+	color = tonemap(color);
+
+	color = lerp(0.5, color, Contrast);
+
+	float3 hsv = rgb_to_hsv(saturate(color));
+	hsv.y *= Saturation;
+	hsv.y += Vibrance * (1.0 - hsv.y) * hsv.y;
+	color = hsv_to_rgb(saturate(hsv));
+
+	color = lift_gamma_gain(color);
+	color = split_tone(color);
+
+	float2 d = (uv - 0.5) * float2(BUFFER_ASPECT_RATIO, 1.0);
+	color *= 1.0 - VignetteAmount * smoothstep(VignetteRadius * 0.5, VignetteRadius, length(d));
+
+	if (FilmGrain > 0.0)
+	{
+		float grain = random(uv, frac(Timer * 0.001)) - 0.5;
+		color += grain * FilmGrain * (1.0 - luminance(color));
+	}
+
+	if (EnableDither)
+	{
+		float noise = random(pos.xy, FrameCount % 64);
+		color += (noise - 0.5) / 255.0;
+	}
+
+	return float4(color, 1.0);
+}
+
+technique ColorGrading
+{
+	pass
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = PS_ColorGrading;
+	}
+}
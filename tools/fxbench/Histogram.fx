@@ -0,0 +1,127 @@
+// Compute-based luminance histogram and auto exposure, representative of effects using compute shaders and storage
+
+#include "ReShade.fxh"
+
+#define HISTOGRAM_BINS 64
+#define HISTOGRAM_TILE 16
+
+uniform float AdaptationSpeed < ui_type = "slider"; ui_min = 0.1; ui_max = 10.0; > = 2.0;
+uniform float MinLuminance < ui_type = "slider"; ui_min = -8.0; ui_max = 0.0; > = -6.0;
+uniform float MaxLuminance < ui_type = "slider"; ui_min = 0.0; ui_max = 8.0; > = 4.0;
+uniform float2 PercentileRange < ui_type = "slider"; ui_min = 0.0; ui_max = 1.0; > = float2(0.5, 0.95);
+uniform float FrameTime < source = "frametime"; >;
+
+texture HistogramTex { Width = HISTOGRAM_BINS; Height = 1; Format = R32F; };
+storage HistogramStorage { Texture = HistogramTex; };
+sampler HistogramSampler { Texture = HistogramTex; MinFilter = POINT; MagFilter = POINT; };
+
+texture ExposureTex { Width = 1; Height = 1; Format = R32F; };
+storage ExposureStorage { Texture = ExposureTex; };
+sampler ExposureSampler { Texture = ExposureTex; MinFilter = POINT; MagFilter = POINT; };
+
+texture PreviousExposureTex { Width = 1; Height = 1; Format = R32F; };
+sampler PreviousExposureSampler { Texture = PreviousExposureTex; MinFilter = POINT; MagFilter = POINT; };
+
+groupshared uint LocalBins[HISTOGRAM_BINS];
+groupshared float Prefix[HISTOGRAM_BINS];
+
+uint luminance_to_bin(float3 color)
+{
+	float l = dot(color, float3(0.2126, 0.7152, 0.0722));
+	if (l < 1e-5)
+		return 0;
+
+	float t = saturate((log2(l) - MinLuminance) / (MaxLuminance - MinLuminance));
+	return (uint)(t * (HISTOGRAM_BINS - 2)) + 1;
+}
+
+void CS_BuildHistogram(uint3 id : SV_DispatchThreadID, uint3 tid : SV_GroupThreadID, uint gi : SV_GroupIndex)
+{
+	if (gi < HISTOGRAM_BINS)
+		LocalBins[gi] = 0;
+	barrier();
+
+	[loop] for (uint y = 0; y < 4; ++y)
+	{
+		[loop] for (uint x = 0; x < 4; ++x)
+		{
+			uint2 coord = id.xy * 4 + uint2(x, y);
+			if (coord.x >= BUFFER_WIDTH || coord.y >= BUFFER_HEIGHT)
+				continue;
+
+			float3 color = tex2Dfetch(ReShade::BackBuffer, coord).rgb;
+			atomicAdd(LocalBins[luminance_to_bin(color)], 1);
+		}
+	}
+	barrier();
+
+	if (gi < HISTOGRAM_BINS)
+	{
+		float count = (float)LocalBins[gi];
+		float previous = tex2Dfetch(HistogramSampler, int2(gi, 0)).x;
+		tex2Dstore(HistogramStorage, int2(gi, 0), float4(previous + count, 0, 0, 0));
+	}
+}
+
+void CS_ComputeExposure(uint3 id : SV_DispatchThreadID, uint gi : SV_GroupIndex)
+{
+	Prefix[gi] = tex2Dfetch(HistogramSampler, int2(gi, 0)).x;
+	barrier();
+
+	// Inclusive prefix sum over all bins
+	[unroll] for (uint offset = 1; offset < HISTOGRAM_BINS; offset *= 2)
+	{
+		float value = gi >= offset ? Prefix[gi - offset] : 0.0;
+		barrier();
+		Prefix[gi] += value;
+		barrier();
+	}
+
+	if (gi != 0)
+		return;
+
+	float total = max(Prefix[HISTOGRAM_BINS - 1], 1.0);
+	float weighted = 0.0;
+	float weight = 0.0;
+
+	for (uint i = 1; i < HISTOGRAM_BINS; ++i)
+	{
+		float lower = (i > 0 ? Prefix[i - 1] : 0.0) / total;
+		float upper = Prefix[i] / total;
+		float amount = saturate(min(upper, PercentileRange.y) - max(lower, PercentileRange.x));
+		float bin_luminance = lerp(MinLuminance, MaxLuminance, (i - 0.5) / (HISTOGRAM_BINS - 2));
+		weighted += bin_luminance * amount;
+		weight += amount;
+	}
+
+	float target = exp2(weighted / max(weight, 1e-4));
+	float previous = tex2Dfetch(PreviousExposureSampler, int2(0, 0)).x;
+	float adapted = previous + (target - previous) * (1.0 - exp(-FrameTime * 0.001 * AdaptationSpeed));
+	tex2Dstore(ExposureStorage, int2(0, 0), float4(adapted, 0, 0, 0));
+}
+
+float4 PS_ClearHistogram(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target
+{
+	return 0.0;
+}
+
+float4 PS_StoreExposure(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target
+{
+	return tex2Dfetch(ExposureSampler, int2(0, 0));
+}
+
+float4 PS_ApplyExposure(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target
+{
+	float3 color = tex2D(ReShade::BackBuffer, uv).rgb;
+	float exposure = 0.18 / max(tex2Dfetch(ExposureSampler, int2(0, 0)).x, 1e-4);
+	return float4(color * exposure, 1.0);
+}
+
+technique AutoExposure
+{
+	pass { VertexShader = PostProcessVS; PixelShader = PS_ClearHistogram; RenderTarget = HistogramTex; }
+	pass { ComputeShader = CS_BuildHistogram<HISTOGRAM_TILE, HISTOGRAM_TILE>; DispatchSizeX = BUFFER_WIDTH / (HISTOGRAM_TILE * 4) + 1; DispatchSizeY = BUFFER_HEIGHT / (HISTOGRAM_TILE * 4) + 1; }
+	pass { ComputeShader = CS_ComputeExposure<HISTOGRAM_BINS, 1>; DispatchSizeX = 1; DispatchSizeY = 1; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_StoreExposure; RenderTarget = PreviousExposureTex; }
+	pass { VertexShader = PostProcessVS; PixelShader = PS_ApplyExposure; }
+}
@@ -6,15 +6,20 @@
 #include "effect_parser.hpp"
 #include "effect_codegen.hpp"
 #include "effect_preprocessor.hpp"
+#include "thread_pool.hpp"
 #include "version.h"
+#include <chrono>
+#include <cstdio> // snprintf
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <algorithm> // std::sort
 
 static void print_usage(const char *path)
 {
 	printf(R"(usage: %s [options] <filename>
+       %s --batch [options] <path>...
 
 Options:
   -h, --help                Print this help.
@@ -29,36 +34,412 @@ Options:
 
   --glsl                    Print GLSL code for the previously specified entry point.
   --hlsl                    Print HLSL code for the previously specified entry point.
+  --spirv                   Generate SPIR-V code (only used in batch mode, where it is the default if neither --glsl nor --hlsl is specified).
   --shader-model <value>    HLSL shader model version. Can be 30, 40, 41, 50, ...
 
   --width                   Value of the 'BUFFER_WIDTH' preprocessor macro.
   --height                  Value of the 'BUFFER_HEIGHT' preprocessor macro.
   --invert-y                Insert code to invert the Y component of the output position in vertex shaders (only applies to SPIR-V).
   --spec-constants          Convert uniform variables to specialization constants.
+  --optimize                Run optimization passes over the generated SPIR-V (inlining, constant folding, dead code elimination).
 
   -Zi                       Enable debug information.
-	)", path);
+
+Batch mode:
+  --batch                   Compile all specified paths in parallel with every selected code generator instead of a single file.
+                            Paths may be files, directories (which are searched recursively for .fx files), file names with * and ? wildcards
+                            or response files prefixed with @ that list one path per line.
+  --report <file>           Write a JSON report with per-stage timings, output sizes and errors of every effect to the given file.
+                            If <file> is "-", then the report is written to standard output instead.
+  -j <count>                Number of threads to compile on. Defaults to the number of hardware threads.
+	)", path, path);
+}
+
+struct compile_options
+{
+	std::vector<std::pair<std::string, std::string>> macros;
+	std::vector<std::filesystem::path> include_paths;
+	bool debug_info = false;
+	bool invert_y_axis = false;
+	bool spec_constants = false;
+	bool optimize = false;
+	unsigned int shader_model = 50;
+};
+
+enum class backend_type
+{
+	spirv,
+	glsl,
+	hlsl,
+};
+
+struct backend_result
+{
+	backend_type type;
+	bool success = false;
+	// Time spent in the parser, which includes emitting code, since it drives the code generator directly
+	double parse_time = 0.0;
+	// Time spent finalizing the generated code into a module
+	double codegen_time = 0.0;
+	size_t output_size = 0;
+	size_t num_entry_points = 0;
+	std::string errors;
+};
+
+struct effect_result
+{
+	std::filesystem::path path;
+	bool success = false;
+	double preprocess_time = 0.0;
+	std::string errors;
+	std::vector<backend_result> backends;
+};
+
+static double elapsed_milliseconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void setup_preprocessor(reshadefx::preprocessor &pp, const compile_options &options)
+{
+	for (const std::filesystem::path &include_path : options.include_paths)
+		pp.add_include_path(include_path);
+
+	pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
+	pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", "0");
+
+	for (const auto &[name, value] : options.macros)
+		pp.add_macro_definition(name, value);
+}
+
+static reshadefx::codegen *create_codegen(backend_type type, const compile_options &options)
+{
+	switch (type)
+	{
+	case backend_type::glsl:
+		return reshadefx::create_codegen_glsl(options.debug_info, options.spec_constants);
+	case backend_type::hlsl:
+		return reshadefx::create_codegen_hlsl(options.shader_model, options.debug_info, options.spec_constants);
+	default:
+		return reshadefx::create_codegen_spirv(true, options.debug_info, options.spec_constants, false, options.invert_y_axis, options.optimize);
+	}
+}
+
+static bool matches_wildcard(const char *name, const char *pattern)
+{
+	for (; *pattern != '\0'; ++pattern, ++name)
+	{
+		if (*pattern == '*')
+		{
+			// Try to match the rest of the pattern at every remaining position in the name
+			for (; *name != '\0'; ++name)
+				if (matches_wildcard(name, pattern + 1))
+					return true;
+			return matches_wildcard(name, pattern + 1);
+		}
+
+		if (*name == '\0' || (*pattern != '?' && *pattern != *name))
+			return false;
+	}
+
+	return *name == '\0';
+}
+
+static bool expand_batch_input(const std::string &input, std::vector<std::filesystem::path> &effect_files)
+{
+	std::error_code ec;
+
+	if (input[0] == '@')
+	{
+		std::ifstream file(input.substr(1));
+		if (!file)
+		{
+			std::cout << "error: Could not open response file '" << input.substr(1) << '\'' << std::endl;
+			return false;
+		}
+
+		for (std::string line; std::getline(file, line);)
+		{
+			// Trim surrounding whitespace (including the carriage return of files with Windows line endings)
+			line.erase(0, line.find_first_not_of(" \t\r"));
+			line.erase(line.find_last_not_of(" \t\r") + 1);
+
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			if (!expand_batch_input(line, effect_files))
+				return false;
+		}
+
+		return true;
+	}
+
+	const std::filesystem::path path = input;
+
+	std::vector<std::filesystem::path> matching_files;
+
+	if (std::filesystem::is_directory(path, ec))
+	{
+		for (const std::filesystem::directory_entry &entry : std::filesystem::recursive_directory_iterator(path, std::filesystem::directory_options::skip_permission_denied, ec))
+			if (entry.path().extension() == ".fx" && !entry.is_directory(ec))
+				matching_files.push_back(entry.path());
+	}
+	else if (const std::string pattern = path.filename().u8string(); pattern.find_first_of("*?") != std::string::npos)
+	{
+		const std::filesystem::path parent_path = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+
+		for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(parent_path, std::filesystem::directory_options::skip_permission_denied, ec))
+			if (!entry.is_directory(ec) && matches_wildcard(entry.path().filename().u8string().c_str(), pattern.c_str()))
+				matching_files.push_back(entry.path());
+	}
+	else
+	{
+		matching_files.push_back(path);
+	}
+
+	if (matching_files.empty())
+	{
+		std::cout << "error: No effect files found for '" << input << '\'' << std::endl;
+		return false;
+	}
+
+	// Directory iteration order is unspecified, so sort to make the results reproducible
+	std::sort(matching_files.begin(), matching_files.end());
+
+	effect_files.insert(effect_files.end(), matching_files.begin(), matching_files.end());
+	return true;
+}
+
+static void compile_effect(effect_result &result, const std::vector<backend_type> &backends, const compile_options &options, reshadefx::include_snapshot_cache &include_snapshots, reshadefx::source_file_cache &source_files)
+{
+	reshadefx::preprocessor pp;
+	pp.set_include_snapshot_cache(&include_snapshots);
+	pp.set_source_file_cache(&source_files);
+	setup_preprocessor(pp, options);
+
+	const auto preprocess_start = std::chrono::steady_clock::now();
+	result.success = pp.append_file(result.path);
+	result.preprocess_time = elapsed_milliseconds(preprocess_start);
+	result.errors = pp.errors();
+
+	if (!result.success)
+	{
+		if (result.errors.empty())
+			result.errors = result.path.u8string() + ": error: Failed to open file\n";
+		return;
+	}
+
+	for (const backend_type type : backends)
+	{
+		backend_result &backend_result = result.backends.emplace_back();
+		backend_result.type = type;
+
+		reshadefx::parser parser;
+		const std::unique_ptr<reshadefx::codegen> backend(create_codegen(type, options));
+
+		const auto parse_start = std::chrono::steady_clock::now();
+		backend_result.success = parser.parse(pp.output(), backend.get());
+		backend_result.parse_time = elapsed_milliseconds(parse_start);
+		backend_result.errors = parser.errors();
+
+		if (backend_result.success)
+		{
+			reshadefx::module module;
+
+			const auto codegen_start = std::chrono::steady_clock::now();
+			backend->write_result(module);
+			backend_result.codegen_time = elapsed_milliseconds(codegen_start);
+
+			backend_result.output_size = (type == backend_type::spirv) ? module.spirv.size() * sizeof(uint32_t) : module.hlsl.size();
+			backend_result.num_entry_points = module.entry_points.size();
+		}
+		else
+		{
+			result.success = false;
+		}
+	}
+}
+
+static void write_json_string(std::ostream &stream, const std::string &value)
+{
+	stream << '\"';
+
+	for (const char c : value)
+	{
+		switch (c)
+		{
+		case '\"':
+			stream << "\\\"";
+			break;
+		case '\\':
+			stream << "\\\\";
+			break;
+		case '\n':
+			stream << "\\n";
+			break;
+		case '\r':
+			stream << "\\r";
+			break;
+		case '\t':
+			stream << "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+			{
+				char temp[8];
+				std::snprintf(temp, sizeof(temp), "\\u%04x", c);
+				stream << temp;
+				break;
+			}
+			stream << c;
+			break;
+		}
+	}
+
+	stream << '\"';
+}
+
+static void write_json_report(std::ostream &stream, const std::vector<effect_result> &results, size_t num_threads, double total_time)
+{
+	static const char *const backend_names[] = { "spirv", "glsl", "hlsl" };
+
+	stream << "{\n";
+	stream << "  \"version\": \"" << VERSION_STRING_PRODUCT << "\",\n";
+	stream << "  \"threads\": " << num_threads << ",\n";
+	stream << "  \"total_time_ms\": " << total_time << ",\n";
+	stream << "  \"effects\": [";
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const effect_result &result = results[i];
+
+		stream << (i == 0 ? "\n" : ",\n");
+		stream << "    {\n";
+		stream << "      \"path\": ";
+		write_json_string(stream, result.path.u8string());
+		stream << ",\n";
+		stream << "      \"success\": " << (result.success ? "true" : "false") << ",\n";
+		stream << "      \"preprocess_time_ms\": " << result.preprocess_time << ",\n";
+		stream << "      \"errors\": ";
+		write_json_string(stream, result.errors);
+		stream << ",\n";
+		stream << "      \"backends\": [";
+
+		for (size_t k = 0; k < result.backends.size(); ++k)
+		{
+			const backend_result &backend_result = result.backends[k];
+
+			stream << (k == 0 ? "\n" : ",\n");
+			stream << "        {\n";
+			stream << "          \"backend\": \"" << backend_names[static_cast<int>(backend_result.type)] << "\",\n";
+			stream << "          \"success\": " << (backend_result.success ? "true" : "false") << ",\n";
+			stream << "          \"parse_time_ms\": " << backend_result.parse_time << ",\n";
+			stream << "          \"codegen_time_ms\": " << backend_result.codegen_time << ",\n";
+			stream << "          \"output_size\": " << backend_result.output_size << ",\n";
+			stream << "          \"entry_points\": " << backend_result.num_entry_points << ",\n";
+			stream << "          \"errors\": ";
+			write_json_string(stream, backend_result.errors);
+			stream << "\n";
+			stream << "        }";
+		}
+
+		stream << (result.backends.empty() ? "]\n" : "\n      ]\n");
+		stream << "    }";
+	}
+
+	stream << (results.empty() ? "]\n" : "\n  ]\n");
+	stream << "}\n";
+}
+
+static int run_batch(const std::vector<std::string> &inputs, const std::vector<backend_type> &backends, const compile_options &options, const char *reportfile, size_t num_threads)
+{
+	std::vector<std::filesystem::path> effect_files;
+	for (const std::string &input : inputs)
+		if (!expand_batch_input(input, effect_files))
+			return 1;
+
+	std::vector<effect_result> results(effect_files.size());
+	for (size_t i = 0; i < effect_files.size(); ++i)
+		results[i].path = std::move(effect_files[i]);
+
+	// Share snapshots of include files between all effects, so that common headers are only processed once
+	reshadefx::include_snapshot_cache include_snapshots;
+	reshadefx::source_file_cache source_files;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	if (num_threads == 1)
+	{
+		for (effect_result &result : results)
+			compile_effect(result, backends, options, include_snapshots, source_files);
+	}
+	else
+	{
+		// The main thread helps executing tasks of the group while waiting, so spawn one less worker thread than requested
+		thread_pool pool(num_threads != 0 ? num_threads - 1 : 0);
+		num_threads = pool.num_threads() + 1;
+
+		task_group tasks(pool);
+		for (effect_result &result : results)
+			tasks.run([&result, &backends, &options, &include_snapshots, &source_files]() {
+				compile_effect(result, backends, options, include_snapshots, source_files);
+			});
+
+		tasks.wait();
+	}
+
+	const double total_time = elapsed_milliseconds(start);
+
+	// Keep standard output clean for the report if it is written there
+	std::ostream &log = (reportfile != nullptr && std::strcmp(reportfile, "-") == 0) ? std::cerr : std::cout;
+
+	size_t num_failed = 0;
+	for (const effect_result &result : results)
+	{
+		if (!result.success)
+			num_failed++;
+
+		log << result.errors;
+
+		// Code generators usually report the same warnings, so only print those that differ from the previous one
+		for (size_t k = 0; k < result.backends.size(); ++k)
+			if (k == 0 || result.backends[k].errors != result.backends[k - 1].errors)
+				log << result.backends[k].errors;
+	}
+
+	log << "Compiled " << results.size() << " effects (" << num_failed << " failed) in " << total_time << " ms" << std::endl;
+
+	if (reportfile != nullptr)
+	{
+		if (std::strcmp(reportfile, "-") == 0)
+			write_json_report(std::cout, results, num_threads, total_time);
+		else if (std::ofstream file(reportfile); file)
+			write_json_report(file, results, num_threads, total_time);
+		else
+		{
+			log << "error: Could not open report file '" << reportfile << '\'' << std::endl;
+			return 1;
+		}
+	}
+
+	return num_failed != 0 ? 1 : 0;
 }
 
 int main(int argc, char *argv[])
 {
-	const char *filename = nullptr;
+	std::vector<std::string> inputs;
 	const char *preprocess = nullptr;
 	const char *errorfile = nullptr;
 	const char *objectfile = nullptr;
+	const char *reportfile = nullptr;
 	const char *buffer_width = "800";
 	const char *buffer_height = "600";
 	bool print_glsl = false;
 	bool print_hlsl = false;
-	bool debug_info = false;
-	bool invert_y_axis = false;
-	bool spec_constants = false;
-	unsigned int shader_model = 50;
-
-	reshadefx::parser parser;
-	reshadefx::preprocessor pp;
-	pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
-	pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", "0");
+	bool generate_spirv = false;
+	bool batch = false;
+	size_t num_threads = 0;
+	compile_options options;
 
 	// Parse command-line arguments
 	for (int i = 1; i < argc; ++i)
@@ -81,26 +462,32 @@ int main(int argc, char *argv[])
 				char *macro = argv[++i];
 				char *value = std::strchr(macro, '=');
 				if (value) *value++ = '\0';
-				pp.add_macro_definition(macro, value ? value : "1");
+				options.macros.emplace_back(macro, value ? value : "1");
 				continue;
 			}
 
 			if (0 == std::strcmp(arg, "-I"))
 			{
-				pp.add_include_path(argv[++i]);
+				options.include_paths.push_back(argv[++i]);
 				continue;
 			}
 
 			if (0 == std::strcmp(arg, "-Zi"))
-				debug_info = true;
+				options.debug_info = true;
 			else if (0 == std::strcmp(arg, "--glsl"))
 				print_glsl = true;
 			else if (0 == std::strcmp(arg, "--hlsl"))
 				print_hlsl = true;
+			else if (0 == std::strcmp(arg, "--spirv"))
+				generate_spirv = true;
 			else if (0 == std::strcmp(arg, "--invert-y"))
-				invert_y_axis = true;
+				options.invert_y_axis = true;
 			else if (0 == std::strcmp(arg, "--spec-constants"))
-				spec_constants = true;
+				options.spec_constants = true;
+			else if (0 == std::strcmp(arg, "--optimize"))
+				options.optimize = true;
+			else if (0 == std::strcmp(arg, "--batch"))
+				batch = true;
 
 			if (i + 1 >= argc)
 				continue;
@@ -110,8 +497,12 @@ int main(int argc, char *argv[])
 				errorfile = argv[++i];
 			else if (0 == std::strcmp(arg, "-Fo"))
 				objectfile = argv[++i];
+			else if (0 == std::strcmp(arg, "--report"))
+				reportfile = argv[++i];
+			else if (0 == std::strcmp(arg, "-j"))
+				num_threads = std::strtoul(argv[++i], nullptr, 10);
 			else if (0 == std::strcmp(arg, "--shader-model"))
-				shader_model = std::strtol(argv[++i], nullptr, 10);
+				options.shader_model = std::strtol(argv[++i], nullptr, 10);
 			else if (0 == std::strcmp(arg, "--width"))
 				buffer_width = argv[++i];
 			else if (0 == std::strcmp(arg, "--height"))
@@ -119,26 +510,45 @@ int main(int argc, char *argv[])
 		}
 		else
 		{
-			if (filename != nullptr)
-			{
-				std::cout << "error: More than one input file specified" << std::endl;
-				return 1;
-			}
-
-			filename = arg;
+			inputs.push_back(arg);
 		}
 	}
 
-	if (filename == nullptr)
+	if (inputs.empty())
 	{
 		print_usage(argv[0]);
 		return 1;
 	}
 
-	pp.add_macro_definition("BUFFER_WIDTH", buffer_width);
-	pp.add_macro_definition("BUFFER_HEIGHT", buffer_height);
-	pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
-	pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+	options.macros.emplace_back("BUFFER_WIDTH", buffer_width);
+	options.macros.emplace_back("BUFFER_HEIGHT", buffer_height);
+	options.macros.emplace_back("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+	options.macros.emplace_back("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+
+	if (batch)
+	{
+		std::vector<backend_type> backends;
+		if (generate_spirv || (!print_glsl && !print_hlsl))
+			backends.push_back(backend_type::spirv);
+		if (print_glsl)
+			backends.push_back(backend_type::glsl);
+		if (print_hlsl)
+			backends.push_back(backend_type::hlsl);
+
+		return run_batch(inputs, backends, options, reportfile, num_threads);
+	}
+
+	if (inputs.size() > 1)
+	{
+		std::cout << "error: More than one input file specified" << std::endl;
+		return 1;
+	}
+
+	const std::string &filename = inputs[0];
+
+	reshadefx::parser parser;
+	reshadefx::preprocessor pp;
+	setup_preprocessor(pp, options);
 
 	if (!pp.append_file(filename))
 	{
@@ -158,13 +568,7 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 
-	std::unique_ptr<reshadefx::codegen> backend;
-	if (print_glsl)
-		backend.reset(reshadefx::create_codegen_glsl(debug_info, spec_constants));
-	else if (print_hlsl)
-		backend.reset(reshadefx::create_codegen_hlsl(shader_model, debug_info, spec_constants));
-	else
-		backend.reset(reshadefx::create_codegen_spirv(true, debug_info, spec_constants, invert_y_axis));
+	const std::unique_ptr<reshadefx::codegen> backend(create_codegen(print_glsl ? backend_type::glsl : print_hlsl ? backend_type::hlsl : backend_type::spirv, options));
 
 	if (!parser.parse(pp.output(), backend.get()))
 	{